@@ -0,0 +1,155 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+/// <summary>
+/// <para> A fixed size pool of worker threads for data parallel loops. </para>
+/// <para> Jobs are passed by reference and never copied, so dispatching does not allocate. </para>
+/// </summary>
+class ThreadPool {
+public:
+    /// <summary>
+    /// Get the shared pool, sized to the hardware (the calling thread counts as one of the threads).
+    /// </summary>
+    static ThreadPool& instance() {
+        static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    explicit ThreadPool(unsigned int workerCount) {
+        for (unsigned int i = 0; i < workerCount; i++) {
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            running = false;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+    }
+
+    /// <summary>
+    /// Number of threads a job is spread over, including the caller.
+    /// </summary>
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    /// <summary>
+    /// Split [0, count) into contiguous chunks and run fn(chunk, begin, end) on each, blocking until all are done.
+    /// </summary>
+    /// <param name="count">Number of items.</param>
+    /// <param name="minChunkSize">Items per chunk below which splitting further is not worth it.</param>
+    /// <param name="fn">Callable taking (unsigned int chunk, size_t begin, size_t end); chunk is below size().</param>
+    template<typename Fn>
+    void parallelFor(size_t count, size_t minChunkSize, const Fn& fn) {
+        if (count == 0) return;
+
+        size_t chunks = std::min<size_t>(size(), (count + minChunkSize - 1) / std::max<size_t>(minChunkSize, 1));
+        if (chunks <= 1) {
+            fn(0u, size_t(0), count);
+            return;
+        }
+
+        // one job at a time, callers from different threads queue up here
+        std::lock_guard<std::mutex> submitLock(submitMtx);
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            job.context = &fn;
+            job.invoke = [](const void* ctx, unsigned int chunk, size_t begin, size_t end) {
+                (*static_cast<const Fn*>(ctx))(chunk, begin, end);
+            };
+            job.count = count;
+            job.chunks = static_cast<unsigned int>(chunks);
+            generation++;
+            remaining.store(job.chunks, std::memory_order_relaxed);
+            nextTicket.store(static_cast<unsigned long long>(generation) << 32, std::memory_order_release);
+        }
+        wake.notify_all();
+
+        // the caller works too
+        runChunks(job, generation);
+
+        std::unique_lock<std::mutex> lock(mtx);
+        done.wait(lock, [this] { return remaining.load(std::memory_order_acquire) == 0; });
+    }
+
+private:
+    struct Job {
+        const void* context = nullptr;
+        void (*invoke)(const void*, unsigned int, size_t, size_t) = nullptr;
+        size_t count = 0;
+        unsigned int chunks = 0;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::mutex submitMtx;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    Job job;
+    unsigned int generation = 0;
+    bool running = true;
+
+    // generation in the high bits, next chunk in the low bits
+    // so a worker that wakes late can never claim a chunk of a newer job
+    std::atomic<unsigned long long> nextTicket{ 0 };
+    std::atomic<unsigned int> remaining{ 0 };
+
+    // prevent copying
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // grab chunks of the given job until none are left
+    void runChunks(const Job& current, unsigned int currentGeneration) {
+        unsigned long long ticket = nextTicket.load(std::memory_order_acquire);
+        for (;;) {
+            if (static_cast<unsigned int>(ticket >> 32) != currentGeneration) return; // a newer job started
+            unsigned int chunk = static_cast<unsigned int>(ticket);
+            if (chunk >= current.chunks) return;
+
+            if (!nextTicket.compare_exchange_weak(ticket, ticket + 1, std::memory_order_acq_rel)) {
+                continue; // ticket was reloaded, try again
+            }
+
+            size_t begin = current.count * chunk / current.chunks;
+            size_t end = current.count * (chunk + 1) / current.chunks;
+            current.invoke(current.context, chunk, begin, end);
+
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(mtx);
+                done.notify_all();
+            }
+            ticket = nextTicket.load(std::memory_order_acquire);
+        }
+    }
+
+    void workerLoop() {
+        unsigned int seen = 0;
+        for (;;) {
+            Job current;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [&] { return !running || generation != seen; });
+                if (!running) return;
+                seen = generation;
+                current = job;
+            }
+            runChunks(current, seen);
+        }
+    }
+};
+
+// declare global
+inline ThreadPool& threadPool = ThreadPool::instance();
@@ -0,0 +1,263 @@
+#include "AllocationTracker.h"
+
+#include <new>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#endif
+
+// the per thread slot, claimed on the thread's first allocation and never given back
+AllocationTracker::Slot& AllocationTracker::threadSlot() {
+	thread_local Slot* slot = nullptr;
+	if (!slot) {
+		AllocationTracker& tracker = instance();
+		int index = tracker.slotCount.fetch_add(1, std::memory_order_relaxed);
+		slot = &tracker.slots[std::min(index, MAX_THREADS - 1)];
+	}
+	return *slot;
+}
+
+void AllocationTracker::setThreadName(const char* name) {
+	threadSlot().name.store(name, std::memory_order_relaxed);
+}
+
+void AllocationTracker::onAllocate(size_t size) {
+	Slot& slot = threadSlot();
+	slot.allocations.fetch_add(1, std::memory_order_relaxed);
+	slot.bytes.fetch_add(size, std::memory_order_relaxed);
+
+	uint32_t every = sampling();
+	if (every == 0) return;
+	thread_local uint64_t counter = 0;
+	if (++counter % every == 0) sample(size);
+}
+
+void AllocationTracker::onFree() {
+	threadSlot().frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AllocationTracker::sample(size_t size) {
+#ifdef __linux__
+	// backtrace loads libgcc and allocates the first time, don't sample that
+	thread_local bool sampling = false;
+	if (sampling) return;
+	sampling = true;
+
+	void* stack[SITE_DEPTH + 1];
+	int depth = backtrace(stack, SITE_DEPTH + 1);
+	if (depth > 1) instance().addSite(stack + 1, depth - 1, size); // skip sample() itself
+
+	sampling = false;
+#else
+	(void)size;
+#endif
+}
+
+void AllocationTracker::addSite(void* const* stack, int depth, size_t size) {
+	uint64_t hash = 14695981039346656037ull;
+	for (int i = 0; i < depth; i++) hash = (hash ^ reinterpret_cast<uintptr_t>(stack[i])) * 1099511628211ull;
+
+	while (siteLock.test_and_set(std::memory_order_acquire)) {}
+
+	// open addressing, a full table drops the sample
+	bool found = false;
+	for (int probe = 0; probe < MAX_SITES && !found; probe++) {
+		Site& site = siteTable[(hash + probe) % MAX_SITES];
+		if (site.allocations == 0) {
+			std::memset(site.stack, 0, sizeof(site.stack));
+			std::memcpy(site.stack, stack, depth * sizeof(void*));
+		}
+		else if (std::memcmp(site.stack, stack, depth * sizeof(void*)) != 0 || (depth < SITE_DEPTH && site.stack[depth])) {
+			continue;
+		}
+		site.allocations++;
+		site.bytes += size;
+		found = true;
+	}
+	if (!found) dropped.fetch_add(1, std::memory_order_relaxed);
+
+	siteLock.clear(std::memory_order_release);
+}
+
+void AllocationTracker::endFrame() {
+	Counts frame;
+	int count = std::min(slotCount.load(std::memory_order_relaxed), MAX_THREADS);
+	for (int i = 0; i < count; i++) {
+		Slot& slot = slots[i];
+		slot.last.allocations = slot.allocations.exchange(0, std::memory_order_relaxed);
+		slot.last.bytes = slot.bytes.exchange(0, std::memory_order_relaxed);
+		slot.last.frees = slot.frees.exchange(0, std::memory_order_relaxed);
+
+		frame.allocations += slot.last.allocations;
+		frame.bytes += slot.last.bytes;
+		frame.frees += slot.last.frees;
+	}
+	frameCounts = frame;
+	totals.allocations += frame.allocations;
+	totals.bytes += frame.bytes;
+	totals.frees += frame.frees;
+}
+
+void AllocationTracker::threads(std::vector<ThreadCounts>& out) const {
+	out.clear();
+	int count = std::min(slotCount.load(std::memory_order_relaxed), MAX_THREADS);
+	for (int i = 0; i < count; i++) {
+		const Slot& slot = slots[i];
+		if (slot.last.allocations == 0 && slot.last.frees == 0) continue;
+		out.push_back({ slot.name.load(std::memory_order_relaxed), slot.last });
+	}
+}
+
+void AllocationTracker::sites(std::vector<Site>& out) const {
+	// growing out under the lock would sample itself
+	out.clear();
+	out.reserve(MAX_SITES);
+
+	while (siteLock.test_and_set(std::memory_order_acquire)) {}
+	for (const Site& site : siteTable) {
+		if (site.allocations > 0) out.push_back(site);
+	}
+	siteLock.clear(std::memory_order_release);
+
+	std::sort(out.begin(), out.end(), [](const Site& a, const Site& b) { return a.allocations > b.allocations; });
+}
+
+void AllocationTracker::resetSites() {
+	while (siteLock.test_and_set(std::memory_order_acquire)) {}
+	for (Site& site : siteTable) site = Site();
+	siteLock.clear(std::memory_order_release);
+	dropped.store(0, std::memory_order_relaxed);
+}
+
+#ifdef __linux__
+
+// dladdr only sees exported symbols, the executable is linked with ENABLE_EXPORTS for that
+static std::string symbolName(void* address) {
+	Dl_info info;
+	if (!dladdr(address, &info)) return "?";
+	if (info.dli_sname) {
+		int status = 0;
+		char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+		std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+		std::free(demangled);
+		return name;
+	}
+
+	// a local symbol, the module and offset still work with addr2line
+	const char* file = info.dli_fname ? info.dli_fname : "?";
+	if (const char* slash = std::strrchr(file, '/')) file = slash + 1;
+	char buffer[256];
+	std::snprintf(buffer, sizeof(buffer), "%s+0x%zx", file, static_cast<size_t>(static_cast<char*>(address) - static_cast<char*>(info.dli_fbase)));
+	return buffer;
+}
+
+// frames of the allocator itself, the tracker and the standard library
+static bool isAllocatorFrame(const std::string& name) {
+	size_t scope = name.find('(');
+	std::string head = name.substr(0, scope);
+	return head.rfind("operator new", 0) == 0 || head.rfind("AllocationTracker::", 0) == 0
+		|| head.rfind("std::", 0) == 0 || head.find(" std::") != std::string::npos
+		|| head.rfind("__gnu_cxx::", 0) == 0 || head.find(" __gnu_cxx::") != std::string::npos
+		|| head.rfind("libstdc++", 0) == 0 || head.rfind("libc.so", 0) == 0;
+}
+
+const char* AllocationTracker::describe(const Site& site) {
+	static std::unordered_map<void*, std::string> names;
+
+	const std::string* last = nullptr;
+	for (void* address : site.stack) {
+		if (!address) break;
+		auto it = names.find(address);
+		if (it == names.end()) it = names.emplace(address, symbolName(address)).first;
+		last = &it->second;
+		if (!isAllocatorFrame(*last)) return last->c_str();
+	}
+	return last ? last->c_str() : "?";
+}
+
+#else
+
+const char* AllocationTracker::describe(const Site&) {
+	return "call sites need Linux";
+}
+
+#endif
+
+#if KESTREL_ALLOC_TRACKING
+
+// the replaced global operators, every form new and delete can take
+// aligned blocks come from posix_memalign, or _aligned_malloc on Windows where they need their own free
+
+#if defined(__GNUC__)
+#define ALLOC_INLINE inline __attribute__((always_inline))
+#else
+#define ALLOC_INLINE inline
+#endif
+
+static ALLOC_INLINE void* allocate(size_t size, size_t alignment, bool aligned) {
+	if (size == 0) size = 1;
+	void* p = nullptr;
+#ifdef _WIN32
+	p = aligned ? _aligned_malloc(size, alignment) : std::malloc(size);
+#else
+	if (!aligned || alignment <= alignof(std::max_align_t)) p = std::malloc(size);
+	else if (posix_memalign(&p, alignment, size) != 0) p = nullptr;
+#endif
+	if (p) AllocationTracker::onAllocate(size);
+	return p;
+}
+
+static ALLOC_INLINE void* allocateOrThrow(size_t size, size_t alignment, bool aligned) {
+	for (;;) {
+		if (void* p = allocate(size, alignment, aligned)) return p;
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) throw std::bad_alloc();
+		handler();
+	}
+}
+
+static ALLOC_INLINE void release(void* p, bool aligned) {
+	if (!p) return;
+	AllocationTracker::onFree();
+#ifdef _WIN32
+	if (aligned) {
+		_aligned_free(p);
+		return;
+	}
+#else
+	(void)aligned;
+#endif
+	std::free(p);
+}
+
+void* operator new(size_t size) { return allocateOrThrow(size, 0, false); }
+void* operator new[](size_t size) { return allocateOrThrow(size, 0, false); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0, false); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0, false); }
+void* operator new(size_t size, std::align_val_t alignment) { return allocateOrThrow(size, static_cast<size_t>(alignment), true); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocateOrThrow(size, static_cast<size_t>(alignment), true); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate(size, static_cast<size_t>(alignment), true); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate(size, static_cast<size_t>(alignment), true); }
+
+void operator delete(void* p) noexcept { release(p, false); }
+void operator delete[](void* p) noexcept { release(p, false); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p, false); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p, false); }
+void operator delete(void* p, size_t) noexcept { release(p, false); }
+void operator delete[](void* p, size_t) noexcept { release(p, false); }
+void operator delete(void* p, std::align_val_t) noexcept { release(p, true); }
+void operator delete[](void* p, std::align_val_t) noexcept { release(p, true); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { release(p, true); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { release(p, true); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { release(p, true); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { release(p, true); }
+
+#endif
\ No newline at end of file
@@ -0,0 +1,106 @@
+// Counts heap allocations through replaced global operator new/delete, per frame and per thread
+// Once warmed up the render path should allocate nothing, --alloc-test fails the run on any frame that does
+// Call sites can be sampled (Linux, backtrace) to find where the allocations come from
+//
+// Built with KESTREL_ALLOC_TRACKING=0 the operators are left alone and every count reads 0
+#pragma once
+
+#ifndef KESTREL_ALLOC_TRACKING
+#define KESTREL_ALLOC_TRACKING 1
+#endif
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class AllocationTracker {
+public:
+	static constexpr int MAX_THREADS = 64;	// threads past this share the last slot
+	static constexpr int MAX_SITES = 256;	// distinct sampled call sites
+	static constexpr int SITE_DEPTH = 12;	// return addresses kept per site
+
+	struct Counts {
+		uint64_t allocations = 0;
+		uint64_t bytes = 0;
+		uint64_t frees = 0;
+	};
+
+	struct ThreadCounts {
+		const char* name; // nullptr if the thread was never named
+		Counts counts;
+	};
+
+	struct Site {
+		void* stack[SITE_DEPTH]; // innermost first, operator new and the tracker included
+		uint64_t allocations;	 // sampled ones only
+		uint64_t bytes;
+	};
+
+	static AllocationTracker& instance() {
+		static AllocationTracker tracker;
+		return tracker;
+	}
+
+	// called by the operators, never allocates
+	static void onAllocate(size_t size);
+	static void onFree();
+
+	// names the calling thread in the per thread counts, the name must stay valid
+	static void setThreadName(const char* name);
+
+	// once per frame on the main thread, everything counted since the last call becomes lastFrame()
+	void endFrame();
+	const Counts& lastFrame() const { return frameCounts; }
+	void threads(std::vector<ThreadCounts>& out) const; // last frame, threads that did anything
+	const Counts& total() const { return totals; } // every frame so far
+
+	// record the call stack of every nth allocation, 0 = off
+	static void setSampling(uint32_t every) { s_SampleEvery.store(every, std::memory_order_relaxed); }
+	static uint32_t sampling() { return s_SampleEvery.load(std::memory_order_relaxed); }
+
+	void sites(std::vector<Site>& out) const; // most sampled first
+	void resetSites();
+	uint64_t droppedSamples() const { return dropped.load(std::memory_order_relaxed); }
+
+	// the first frame of the site outside the allocator and the standard library, demangled
+	// resolved once per address and cached, main thread only
+	static const char* describe(const Site& site);
+
+	static bool available() { return KESTREL_ALLOC_TRACKING != 0; }
+
+private:
+	struct Slot {
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> bytes{ 0 };
+		std::atomic<uint64_t> frees{ 0 };
+		Counts last;
+	};
+
+	// constant initialized and trivially destroyed, so the operators can count
+	// before main and after every other static is gone
+	constexpr AllocationTracker() = default;
+
+	// prevent copying
+	AllocationTracker(const AllocationTracker&) = delete;
+	AllocationTracker& operator=(const AllocationTracker&) = delete;
+
+	static inline std::atomic<uint32_t> s_SampleEvery{ 0 };
+
+	static Slot& threadSlot();
+	static void sample(size_t size);
+	void addSite(void* const* stack, int depth, size_t size);
+
+	Slot slots[MAX_THREADS];
+	std::atomic<int> slotCount{ 0 };
+	Counts frameCounts;
+	Counts totals;
+
+	Site siteTable[MAX_SITES] = {};
+	mutable std::atomic_flag siteLock = ATOMIC_FLAG_INIT;
+	std::atomic<uint64_t> dropped{ 0 };
+};
+
+// declare global
+inline AllocationTracker& allocationTracker = AllocationTracker::instance();
\ No newline at end of file
@@ -1,6 +1,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include <chrono>
+#include <fstream>
 
 #include "App.h"
 
@@ -63,13 +64,28 @@ static void mouse_button_callback(GLFWwindow* window, int button, int action, in
 }
 
 // app constructor
-App::App(int w, int h, const char* t) 
-	: window(nullptr), width(w), height(h), title(t) {
+App::App(int w, int h, const char* t, const Options& o) 
+	: window(nullptr), width(w), height(h), title(t), options(o) {
 	init();
 }
 App::~App() {}
 
 void App::init() {
+	CpuProfiler::setThreadName("Main");
+	HardwareCounters::registerThread();
+	AllocationTracker::setThreadName("Main");
+	if (!options.trace.empty()) CpuProfiler::setEnabled(true);
+	if (options.hardwareCounters) hardwareCounters.enable();
+	if (options.hitchCaptureMs > 0.0f) {
+		flightRecorder.thresholdMs = options.hitchCaptureMs;
+		flightRecorder.arm(true);
+	}
+
+	// headless hosts have no display server, GLFW's null platform needs no connection to one
+#ifdef GLFW_PLATFORM_NULL
+	if (options.headless) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+
 	// initialize GLFW
 	if (!glfwInit()) {
 		std::cerr << "Failed to initialize GLFW\n";
@@ -81,33 +97,27 @@ void App::init() {
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-	// create a window
-	window = glfwCreateWindow(width, height, title, nullptr, nullptr);
-	if (window == NULL) {
+	// create a window, or just a context
+	if (!(options.headless ? createHeadlessContext() : createWindow())) {
 		std::cerr << "Failed to create a GLFW window\n";
 		glfwTerminate();
 		std::exit(EXIT_FAILURE);
 	}
 
-	// center window
-	GLFWmonitor* primary = glfwGetPrimaryMonitor();
-	const GLFWvidmode* mode = glfwGetVideoMode(primary);
-	int xpos = (mode->width - width) / 2;
-	int ypos = (mode->height - height) / 2;
-	glfwSetWindowPos(window, xpos, ypos);
-
 	glfwMakeContextCurrent(window);
 	glfwSetWindowUserPointer(window, this);
 
 	// disable vsync >:)
 	glfwSwapInterval(0);
 
-	// setup callbacks
-	setupCallbacks();
+	if (!options.headless) {
+		// setup callbacks
+		setupCallbacks();
 
-	// cursor config
-	// TOOD: review; shouldnt this already be handled by one of the callbacks above?
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL); // normal mode
+		// cursor config
+		// TOOD: review; shouldnt this already be handled by one of the callbacks above?
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL); // normal mode
+	}
 
 	// load GLAD OpenGL function pointers
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -120,11 +130,12 @@ void App::init() {
 	logger.info("GLSL Version: " + std::string((const char*)glGetString(GL_SHADING_LANGUAGE_VERSION)));
 
 	// initialize ImGui
-	gui.init(this, window);
+	if (!options.headless) gui.init(this, window);
 
 	// initialize viewport
-	int fbWidth, fbHeight;
-	glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+	// headless renders at the requested size, the context's own framebuffer is never shown
+	int fbWidth = width, fbHeight = height;
+	if (!options.headless) glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
 	glViewport(0, 0, fbWidth, fbHeight);
 
 	// setup OpenGL configurations here
@@ -143,18 +154,71 @@ void App::init() {
 
 	// open a debug scene
 	auto start = std::chrono::high_resolution_clock::now();
-	// TODO: load scene here
-	loadScene01(*scene);
+	{
+		PROFILE_ZONE("App::loadScene");
+		if (!loadSceneByName(options.scene, *scene)) {
+			logger.error("unknown scene: " + options.scene);
+			std::exit(EXIT_FAILURE);
+		}
+	}
 	auto end = std::chrono::high_resolution_clock::now();
 	std::chrono::duration<double, std::milli> duration = end - start;
 
 	// initialize renderer instance
 	renderer.init(*scene);
+	renderer.resize(fbWidth, fbHeight);
+	renderer.presentToScreen = !options.headless;
 
 	logger.info("Scene loaded in " + std::to_string(duration.count()) + " ms");
+
+	// benchmark
+	if (!options.benchmarkPath.empty()) {
+		if (!benchmark.path.load(options.benchmarkPath)) std::exit(EXIT_FAILURE);
+		benchmark.sceneName = options.scene;
+		benchmark.frameCount = options.frames > 0 ? options.frames : static_cast<int>(benchmark.path.duration() / benchmark.timestep) + 1;
+	}
 	logger.info("ended initialization");
 }
 
+bool App::createWindow() {
+	window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+	if (!window) return false;
+
+	// center window
+	GLFWmonitor* primary = glfwGetPrimaryMonitor();
+	if (primary) {
+		const GLFWvidmode* mode = glfwGetVideoMode(primary);
+		int xpos = (mode->width - width) / 2;
+		int ypos = (mode->height - height) / 2;
+		glfwSetWindowPos(window, xpos, ypos);
+	}
+	return true;
+}
+
+bool App::createHeadlessContext() {
+	// the window is never shown, it only carries the context; all rendering goes to the renderer's FBOs
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	// surfaceless contexts first: OSMesa runs on llvmpipe without any GPU, EGL covers GPU hosts without a display
+	// then whatever the platform offers by default
+	const int apis[] = {
+#ifdef GLFW_OSMESA_CONTEXT_API
+		GLFW_OSMESA_CONTEXT_API,
+#endif
+		GLFW_EGL_CONTEXT_API,
+		GLFW_NATIVE_CONTEXT_API,
+	};
+	for (int api : apis) {
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+		window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+		if (window) {
+			logger.info("headless context created (" + std::to_string(width) + "x" + std::to_string(height) + ")");
+			return true;
+		}
+	}
+	return false;
+}
+
 void App::setupCallbacks() {
 	// the problem is that we store our callback functions in C++ classes, but glfw requires C functions
 	// workaround is to format as C functions that call into the C++ classes
@@ -171,42 +235,243 @@ void App::run() {
 	// main stuff happens in this function here
 	float lastTime = 0.0f;
 
+	// CPU side of a frame, runs on the pipeline thread when pipelined
+	pipeline.start([this](float dt) {
+		scene->update(dt);
+		renderer.prepare(*scene, snapshots[prepareSlot]);
+	});
+
+	// from here on GL calls happen on the render thread only
+	renderThread.start(window);
+
 	// main execution loop below
 	// per-frame logic
-	while (!glfwWindowShouldClose(window)) {
+	const bool interactive = !options.headless;
+	const bool benchmarking = !options.benchmarkPath.empty();
+	if (benchmarking) benchmark.begin();
+
+	using clock = std::chrono::steady_clock;
+	auto frameEnd = clock::now();
+	float lastFrameMs = -1.0f; // nothing rendered yet
+
+	for (int frame = 0; !glfwWindowShouldClose(window); frame++) {
+		if (benchmarking ? benchmark.done() : (options.frames > 0 && frame >= options.frames)) break;
+
+		// the last frame's zone closed at the end of the previous iteration
+		cpuProfiler.endFrame();
+		hardwareCounters.endFrame();
+		allocationTracker.endFrame();
+		if (options.allocationTest && frame > 0) checkAllocations(frame - 1);
+		if (lastFrameMs >= 0.0f) flightRecorder.endFrame(lastFrameMs, renderStats.lastFrame());
+		PROFILE_ZONE("App::run");
+
 		float currentTime = glfwGetTime();
 		float deltaTime = currentTime - lastTime;
 		lastTime = currentTime;
 
-		// process continuous input
-		// this is needed for non-discrete functionality that depend on deltatime
-		processInput(deltaTime);
+		// benchmarks simulate a fixed step so every run sees the same frames
+		if (benchmarking) deltaTime = benchmark.timestep;
+
+		// callbacks, input and the gui all touch the scene, which is only safe while the worker is idle
+		{
+			PROFILE_ZONE("App::waitPipeline");
+			pipeline.wait();
+		}
+		auto frameStart = clock::now();
+
+		if (interactive) {
+			glfwPollEvents();
+
+			// process continuous input
+			// this is needed for non-discrete functionality that depend on deltatime
+			processInput(deltaTime);
+		}
+
+		if (benchmarking) {
+			benchmark.path.apply(benchmark.time(), scene->camera);
+		}
+		else if (recordingPath) {
+			recordingTime += deltaTime;
+			if (recordedPath.keys.empty() || recordingTime - recordedPath.keys.back().time >= 0.1f) {
+				recordedPath.record(recordingTime, scene->camera);
+			}
+		}
+
+		// recompiling needs the context, only round trip to the render thread when a source changed
+		if (renderer.shadersChanged(*scene)) {
+			renderThread.run([this] { renderer.reloadShaders(*scene); });
+		}
+
+		if (interactive) {
+			// clear render buffers
+			commands.bindFramebuffer(GL_FRAMEBUFFER, 0);
+			commands.clearColor(glm::vec4(0.05f, 0.05f, 0.05f, 1.0f));
+			commands.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// clear render buffers
-		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			// draw gui
+			gui.beginFrame();
+			gui.draw();
+		}
+
+		// quality changes that resize GPU targets go through the render thread, before anything is recorded
+		if (governor.update(gui.averageFrameTime(), deltaTime)) {
+			governor.apply(renderer);
+		}
+		if (renderer.targetsOutdated()) {
+			renderThread.run([this] { renderer.updateTargets(); });
+		}
+
+		if (pipelined && snapshotReady) {
+			// hand the worker the other slot and record the frame it finished last
+			int submitSlot = prepareSlot;
+			prepareSlot ^= 1;
+			pipeline.kick(deltaTime);
 
-		// draw gui
-		gui.beginFrame();
-		gui.draw();
+			renderer.submit(*scene, snapshots[submitSlot], commands);
+		}
+		else {
+			// update scene
+			scene->update(deltaTime);
 
-		// update scene
-		scene->update(deltaTime);
+			// render
+			renderer.prepare(*scene, snapshots[prepareSlot]);
+			renderer.submit(*scene, snapshots[prepareSlot], commands);
 
-		// render
-		renderer.render(*scene);
+			// when pipelining was just switched on, this frame primes the pipeline
+			// and is submitted a second time while the worker prepares the next one
+			snapshotReady = pipelined;
+		}
 
 		// end frame
-		gui.endFrame();
+		if (interactive) {
+			renderer.beginPass(commands, Renderer::PASS_GUI);
+			gui.endFrame(commands);
+			renderer.endPass(commands, Renderer::PASS_GUI);
+		}
+
+		auto recordEnd = clock::now();
+
+		// replay and present on the render thread
+		{
+			PROFILE_ZONE("App::waitRenderThread");
+			renderThread.waitIdle();
+		}
+		renderer.syncStats();
+		renderThread.submit(commands);
+
+		auto now = clock::now();
+		float frameMs = std::chrono::duration<float, std::milli>(now - frameEnd).count();
+		frameStats.add(frameMs);
+		lastFrameMs = frameMs;
+		if (benchmarking) {
+			benchmark.addFrame(
+				frameMs,
+				std::chrono::duration<float, std::milli>(recordEnd - frameStart).count(),
+				renderer.gpuProfiler.frameTime(),
+				renderStats.lastFrame(),
+				hardwareCounters.lastFrame());
+		}
+		frameEnd = now;
+	}
+
+	pipeline.wait();
+	pipeline.stop();
+	renderThread.stop();
+
+	if (!options.screenshot.empty()) saveScreenshot(options.screenshot);
+	if (benchmarking) benchmark.write(options.benchmarkOut);
+	if (recordingPath) stopPathRecording("camera_path.txt");
+	if (!options.trace.empty()) cpuProfiler.writeChromeTrace(options.trace);
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+	if (options.allocationTest) {
+		if (!AllocationTracker::available()) {
+			logger.warning("alloc test: built with KESTREL_ALLOC_TRACKING=0, nothing was checked");
+		}
+		else if (checkedFrames == 0) {
+			logger.warning("alloc test: no frames past the " + std::to_string(ALLOC_TEST_WARMUP) + " frame warmup, nothing was checked");
+		}
+		else if (allocatingFrames > 0) {
+			logger.error("alloc test failed: " + std::to_string(allocatingFrames) + " of " + std::to_string(checkedFrames) + " frames allocated");
+			failed = true;
+		}
+		else {
+			logger.info("alloc test passed: " + std::to_string(checkedFrames) + " frames without an allocation");
+		}
 	}
 
 	cleanup();
 }
 
+void App::checkAllocations(int frame) {
+	// sample every allocation well before the checked frames, the first backtrace loads the unwinder and allocates
+	if (frame == ALLOC_TEST_WARMUP / 2) AllocationTracker::setSampling(1);
+	if (frame == ALLOC_TEST_WARMUP - 1) allocationTracker.resetSites();
+	if (frame < ALLOC_TEST_WARMUP) return;
+
+	checkedFrames++;
+	const auto& counts = allocationTracker.lastFrame();
+	if (counts.allocations == 0) return;
+
+	// reporting allocates as well, so only the first frame gets the details
+	if (allocatingFrames++ > 0) return;
+
+	logger.error("alloc test: frame " + std::to_string(frame) + " made " + std::to_string(counts.allocations)
+		+ " allocations, " + std::to_string(counts.bytes) + " bytes");
+
+	std::vector<AllocationTracker::ThreadCounts> threads;
+	allocationTracker.threads(threads);
+	for (const auto& thread : threads) {
+		if (thread.counts.allocations == 0) continue;
+		logger.error(std::string("  thread ") + (thread.name ? thread.name : "unnamed") + ": "
+			+ std::to_string(thread.counts.allocations) + " allocations, " + std::to_string(thread.counts.bytes) + " bytes");
+	}
+
+	std::vector<AllocationTracker::Site> sites;
+	allocationTracker.sites(sites);
+	for (size_t i = 0; i < sites.size() && i < 8; i++) {
+		logger.error("  " + std::to_string(sites[i].allocations) + "x " + AllocationTracker::describe(sites[i]));
+	}
+}
+
+void App::startPathRecording() {
+	recordedPath.keys.clear();
+	recordingTime = 0.0f;
+	recordingPath = true;
+}
+
+void App::stopPathRecording(const std::string& path) {
+	recordingPath = false;
+	recordedPath.record(recordingTime, scene->camera);
+	recordedPath.save(path);
+}
+
+void App::saveScreenshot(const std::string& path) {
+	int w = 0, h = 0;
+	std::vector<unsigned char> pixels;
+	renderer.readSceneColor(pixels, w, h);
+	if (pixels.empty()) return;
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		logger.error("Failed to write screenshot: " + path);
+		return;
+	}
+
+	// GL rows start at the bottom
+	file << "P6\n" << w << " " << h << "\n255\n";
+	for (int y = h - 1; y >= 0; y--) {
+		file.write(reinterpret_cast<const char*>(&pixels[static_cast<size_t>(y) * w * 3]), static_cast<std::streamsize>(w) * 3);
+	}
+	logger.info("Saved screenshot: " + path);
+}
+
 void App::cleanup() {
+	// everything that owns GL objects goes while the context is still alive
+	scene.reset();
+	renderer.release();
+	gui.shutdown();
+	resources.reportLeaks();
+
 	if (window) {
 		glfwDestroyWindow(window);
 		window = nullptr;
@@ -239,7 +504,6 @@ void App::processInput(float dt) {
 
 // callbacks
 void App::onFrameBufferSize(int w, int h) {
-	glViewport(0, 0, w, h);
 	width = w;
 	height = h;
 
@@ -247,6 +511,12 @@ void App::onFrameBufferSize(int w, int h) {
 	if (scene) {
 		scene->camera.setViewport(w, h);
 	}
+
+	// resize offscreen targets
+	renderThread.run([this, w, h] {
+		glViewport(0, 0, w, h);
+		renderer.resize(w, h);
+	});
 }
 
 void App::onCursorPos(double xPos, double yPos) {
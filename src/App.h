@@ -12,16 +12,53 @@
 #include "Renderer.h"
 #include "Scene.h"
 #include "Gui.h"
+#include "FramePipeline.h"
+#include "RenderThread.h"
+#include "QualityGovernor.h"
+#include "Benchmark.h"
+#include "CpuProfiler.h"
+#include "HardwareCounters.h"
+#include "FrameStats.h"
+#include "FlightRecorder.h"
+#include "AllocationTracker.h"
 
 #include "logger.h"
 #include "eventbus.h"
 
+// command line switches, see main.cpp
+struct AppOptions {
+    bool headless = false;  // offscreen context at a fixed size, no window, input or gui
+    int frames = 0;         // stop after this many frames, 0 = until the window is closed
+    std::string screenshot; // write the last frame here (binary .ppm)
+    std::string scene = "scene01"; // see loadSceneByName() in debug.cpp
+
+    // benchmark: play this camera path at a fixed timestep and write timings to <benchmarkOut>.csv/.json
+    // frames is then the number of recorded frames, by default enough to cover the path
+    std::string benchmarkPath;
+    std::string benchmarkOut = "benchmark";
+
+    // profile the CPU from startup and write a Chrome trace here on exit
+    std::string trace;
+
+    // arm the flight recorder, frames slower than this (ms) are captured, 0 = off
+    float hitchCaptureMs = 0.0f;
+
+    // count cycles, instructions and cache/branch misses with perf_event_open (Linux, if permitted)
+    bool hardwareCounters = false;
+
+    // fail the run (exit code 1) if any frame after the warmup allocates, logging where from
+    bool allocationTest = false;
+};
+
 class App {
 public:
-    App(int width, int height, const char* title);
+    using Options = AppOptions;
+
+    App(int width, int height, const char* title, const Options& options = Options());
     ~App();
     
     void run(); // execution loop
+    int exitCode() const { return failed ? 1 : 0; }
     
     // callback handlers
     void onFrameBufferSize(int width, int height);
@@ -31,6 +68,27 @@ public:
     
     std::unique_ptr<Scene> scene; // single scene instance
     Renderer renderer;
+
+    // owns the GL context once the main loop runs, one-off GL work has to go through renderThread.run()
+    RenderThread renderThread;
+
+    // update + prepare frame N+1 on a worker while frame N is submitted
+    // input and gui changes then reach the screen one frame later
+    bool pipelined = false;
+
+    // lowers (and restores) render settings to hold a frame time target, off by default
+    QualityGovernor governor;
+
+    // frame time percentiles and hitches over sliding windows, fed every frame
+    FrameStats frameStats;
+
+    // writes the last frames' zones and counters to disk when one takes too long
+    FlightRecorder flightRecorder;
+
+    // camera path recording, for benchmark runs
+    void startPathRecording();
+    void stopPathRecording(const std::string& path);
+    bool recordingPath = false;
     //EventBus bus;
 
     void processInput(float dt);
@@ -50,6 +108,30 @@ private:
     GLFWwindow* window = nullptr;
     int width, height;
     const char* title;
+    Options options;
+
+    bool createWindow();
+    bool createHeadlessContext();
+    void saveScreenshot(const std::string& path);
 
     Gui gui;
+
+    CommandBuffer commands; // recorded by the main thread each frame, replayed by renderThread
+
+    Benchmark benchmark;
+    CameraPath recordedPath;
+    float recordingTime = 0.0f;
+
+    FramePipeline pipeline;
+
+    Renderer::FrameSnapshot snapshots[2];
+    int prepareSlot = 0;		// snapshot the worker writes next
+    bool snapshotReady = false;	// snapshots[prepareSlot] holds a frame that has not been submitted
+
+    // --alloc-test, frames before the warmup fill caches and grow buffers to their steady size
+    static const int ALLOC_TEST_WARMUP = 120;
+    int checkedFrames = 0;
+    int allocatingFrames = 0;
+    void checkAllocations(int frame);
+    bool failed = false;
 };
\ No newline at end of file
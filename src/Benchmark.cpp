@@ -0,0 +1,218 @@
+#include "Benchmark.h"
+
+#include <logger.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+
+bool CameraPath::load(const std::string& path) {
+	std::ifstream file(path);
+	if (!file) {
+		logger.error("Failed to open camera path: " + path);
+		return false;
+	}
+
+	keys.clear();
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#') continue;
+
+		std::istringstream in(line);
+		Key key;
+		if (in >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch) {
+			keys.push_back(key);
+		}
+	}
+
+	std::stable_sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) { return a.time < b.time; });
+	logger.info("loaded camera path: " + path + " (" + std::to_string(keys.size()) + " keys, " + std::to_string(duration()) + " s)");
+	return !keys.empty();
+}
+
+bool CameraPath::save(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file) {
+		logger.error("Failed to write camera path: " + path);
+		return false;
+	}
+
+	file << "# time x y z yaw pitch\n";
+	for (const Key& key : keys) {
+		file << key.time << " " << key.position.x << " " << key.position.y << " " << key.position.z << " " << key.yaw << " " << key.pitch << "\n";
+	}
+	logger.info("saved camera path: " + path + " (" + std::to_string(keys.size()) + " keys)");
+	return true;
+}
+
+void CameraPath::apply(float time, Camera& camera) const {
+	if (keys.empty()) return;
+
+	// first key after time
+	auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const Key& key) { return t < key.time; });
+
+	Key pose;
+	if (next == keys.begin()) pose = keys.front();
+	else if (next == keys.end()) pose = keys.back();
+	else {
+		const Key& a = *(next - 1);
+		const Key& b = *next;
+		float t = (time - a.time) / std::max(b.time - a.time, 1e-6f);
+		pose.position = glm::mix(a.position, b.position, t);
+		pose.yaw = glm::mix(a.yaw, b.yaw, t);
+		pose.pitch = glm::mix(a.pitch, b.pitch, t);
+	}
+
+	camera.position = pose.position;
+	camera.yaw = pose.yaw;
+	camera.pitch = pose.pitch;
+	camera.updateVectors();
+}
+
+void CameraPath::record(float time, const Camera& camera) {
+	keys.push_back({ time, camera.position, camera.yaw, camera.pitch });
+}
+
+void Benchmark::begin() {
+	frame = 0;
+	frames.clear();
+	gpuSamples.clear();
+	hwSamples.clear();
+	frames.reserve(totalFrames());
+	gpuSamples.reserve(totalFrames());
+	hwSamples.reserve(totalFrames());
+	logger.info("benchmark: " + std::to_string(warmupFrames) + " warmup + " + std::to_string(frameCount) + " frames at " + std::to_string(timestep * 1000.0f) + " ms steps");
+}
+
+void Benchmark::addFrame(float frameMs, float cpuMs, float gpuMs, const RenderStats::Frame& counters, const HardwareCounters::Values& hw) {
+	frames.push_back({ frameMs, cpuMs, 0.0f, counters, HardwareCounters::Values() });
+	gpuSamples.push_back(gpuMs);
+	hwSamples.push_back(hw);
+	frame++;
+}
+
+struct Summary {
+	double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+// nearest rank percentiles
+static Summary summarize(std::vector<float> values) {
+	Summary s;
+	if (values.empty()) return s;
+
+	std::sort(values.begin(), values.end());
+	auto rank = [&](double p) { return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))]; };
+
+	for (float v : values) s.mean += v;
+	s.mean /= values.size();
+	s.p50 = rank(0.50);
+	s.p95 = rank(0.95);
+	s.p99 = rank(0.99);
+	s.max = values.back();
+	return s;
+}
+
+// "Draw calls" -> draw_calls
+static std::string columnName(const char* name) {
+	std::string column;
+	for (const char* c = name; *c; c++) column += *c == ' ' ? '_' : static_cast<char>(std::tolower(*c));
+	return column;
+}
+
+// as a JSON string body, same escaping as the profiler's trace
+static void writeEscaped(std::ofstream& file, const std::string& text) {
+	for (char c : text) {
+		if (c == '"' || c == '\\') file << '\\';
+		file << c;
+	}
+}
+
+static void writeSummary(std::ofstream& file, const char* name, const Summary& s, bool last) {
+	file << "    \"" << name << "\": { \"mean\": " << s.mean << ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95
+		<< ", \"p99\": " << s.p99 << ", \"max\": " << s.max << " }" << (last ? "\n" : ",\n");
+}
+
+bool Benchmark::write(const std::string& prefix) const {
+	// the recorded frames, with the GPU time and hardware counts that were measured for them later
+	std::vector<Frame> recorded;
+	int latency = std::max(GPU_LATENCY, HW_LATENCY);
+	bool hasHw = false;
+	for (int i = warmupFrames; i < warmupFrames + frameCount && i + latency < static_cast<int>(frames.size()); i++) {
+		Frame f = frames[i];
+		f.gpuMs = gpuSamples[i + GPU_LATENCY];
+		f.hw = hwSamples[i + HW_LATENCY];
+		hasHw = hasHw || f.hw[HardwareCounters::Cycles] > 0;
+		recorded.push_back(f);
+	}
+
+	std::ofstream csv(prefix + ".csv");
+	std::ofstream json(prefix + ".json");
+	if (!csv || !json) {
+		logger.error("Failed to write benchmark results: " + prefix);
+		return false;
+	}
+
+	csv << "frame,frame_ms,cpu_ms,gpu_ms";
+	for (int c = 0; c < RenderStats::COUNT; c++) csv << "," << columnName(RenderStats::name(c));
+	if (hasHw) {
+		for (int c = 0; c < HardwareCounters::COUNT; c++) csv << "," << columnName(HardwareCounters::name(c));
+	}
+	csv << "\n";
+
+	std::vector<float> frameMs, cpuMs, gpuMs;
+	double counterSums[RenderStats::COUNT] = {};
+	HardwareCounters::Values hwSum;
+	for (size_t i = 0; i < recorded.size(); i++) {
+		const Frame& f = recorded[i];
+		csv << i << "," << f.frameMs << "," << f.cpuMs << "," << f.gpuMs;
+		for (int c = 0; c < RenderStats::COUNT; c++) {
+			csv << "," << f.counters[c];
+			counterSums[c] += static_cast<double>(f.counters[c]);
+		}
+		if (hasHw) {
+			for (int c = 0; c < HardwareCounters::COUNT; c++) csv << "," << f.hw[c];
+			hwSum += f.hw;
+		}
+		csv << "\n";
+		frameMs.push_back(f.frameMs);
+		cpuMs.push_back(f.cpuMs);
+		gpuMs.push_back(f.gpuMs);
+	}
+
+	Summary frameSummary = summarize(frameMs);
+	json << "{\n";
+	json << "  \"scene\": \"";
+	writeEscaped(json, sceneName);
+	json << "\",\n";
+	json << "  \"frames\": " << recorded.size() << ",\n";
+	json << "  \"warmup_frames\": " << warmupFrames << ",\n";
+	json << "  \"timestep\": " << timestep << ",\n";
+	json << "  \"ms\": {\n";
+	writeSummary(json, "frame", frameSummary, false);
+	writeSummary(json, "cpu", summarize(cpuMs), false);
+	writeSummary(json, "gpu", summarize(gpuMs), true);
+	json << "  },\n";
+
+	// per frame means
+	json << "  \"counters\": {\n";
+	for (int c = 0; c < RenderStats::COUNT; c++) {
+		double mean = recorded.empty() ? 0.0 : counterSums[c] / recorded.size();
+		json << "    \"" << columnName(RenderStats::name(c)) << "\": " << mean << (c + 1 < RenderStats::COUNT ? ",\n" : "\n");
+	}
+	json << (hasHw ? "  },\n" : "  }\n");
+
+	// per frame means over all counted threads
+	if (hasHw) {
+		json << "  \"hardware\": {\n";
+		for (int c = 0; c < HardwareCounters::COUNT; c++) {
+			json << "    \"" << columnName(HardwareCounters::name(c)) << "\": " << static_cast<double>(hwSum[c]) / recorded.size() << ",\n";
+		}
+		json << "    \"ipc\": " << hwSum.ipc() << "\n";
+		json << "  }\n";
+	}
+	json << "}\n";
+
+	logger.info("benchmark: " + std::to_string(recorded.size()) + " frames, frame time mean " + std::to_string(frameSummary.mean)
+		+ " ms, p95 " + std::to_string(frameSummary.p95) + " ms, p99 " + std::to_string(frameSummary.p99) + " ms -> " + prefix + ".json/.csv");
+	return true;
+}
\ No newline at end of file
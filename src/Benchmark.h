@@ -0,0 +1,80 @@
+// Scripted, reproducible performance runs
+// A keyframed camera path is played back at a fixed simulated timestep and every frame's timings are kept,
+// then written out as CSV (per frame) and JSON (summary) so builds can be compared
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "Camera.h"
+#include "RenderStats.h"
+#include "HardwareCounters.h"
+
+class CameraPath {
+public:
+	struct Key {
+		float time; // seconds from the start of the path
+		glm::vec3 position;
+		float yaw;
+		float pitch;
+	};
+
+	std::vector<Key> keys; // sorted by time
+
+	// plain text, one "time x y z yaw pitch" per line, lines starting with # are ignored
+	bool load(const std::string& path);
+	bool save(const std::string& path) const;
+
+	float duration() const { return keys.empty() ? 0.0f : keys.back().time; }
+
+	// interpolate the pose at time and put it on the camera, holds the first/last key outside the path
+	void apply(float time, Camera& camera) const;
+
+	// append the camera's current pose
+	void record(float time, const Camera& camera);
+};
+
+class Benchmark {
+public:
+	// GPU timestamps are read back a few frames late, see GpuProfiler
+	// recorded in frame N, read back while N + 2 is replayed and picked up by syncStats() in N + 3
+	static constexpr int GPU_LATENCY = 3;
+	// hardware counters are totalled at the start of the next frame
+	static constexpr int HW_LATENCY = 1;
+
+	struct Frame {
+		float frameMs;	// wall time of the whole frame
+		float cpuMs;	// main thread work: update, prepare and recording, without waiting on the render thread
+		float gpuMs;	// GPU time from the first pass starting to the last one ending
+		RenderStats::Frame counters; // recorded work, see RenderStats
+		HardwareCounters::Values hw;  // all zero unless hardware counters are enabled
+	};
+
+	std::string sceneName;
+	CameraPath path;
+	float timestep = 1.0f / 60.0f;	// simulated seconds per frame, independent of how fast frames really are
+	int warmupFrames = 30;			// rendered but not recorded, lets caches and drivers settle
+	int frameCount = 0;				// recorded frames
+
+	void begin();
+	bool done() const { return frame >= totalFrames(); }
+
+	// the simulated time of the frame about to be rendered
+	float time() const { return frame * timestep; }
+
+	// call once per rendered frame; gpuMs is whatever the timers hold now, it is lined up with the right frame later
+	void addFrame(float frameMs, float cpuMs, float gpuMs, const RenderStats::Frame& counters, const HardwareCounters::Values& hw);
+
+	// writes <prefix>.csv and <prefix>.json
+	bool write(const std::string& prefix) const;
+
+private:
+	int frame = 0;
+	std::vector<Frame> frames;
+	std::vector<float> gpuSamples;
+	std::vector<HardwareCounters::Values> hwSamples;
+
+	int totalFrames() const { return warmupFrames + frameCount + std::max(GPU_LATENCY, HW_LATENCY); }
+};
\ No newline at end of file
@@ -25,6 +25,8 @@ public:
     float sensitivity = 0.09f;
     float speed = 5.0f;
     float fov = 36.0f;
+    float nearPlane = 0.1f;
+    float farPlane = 400.0f;
 
     // constructor
     Camera(glm::vec3 pos = glm::vec3(0.0f, 0.0f, 3.0f),
@@ -47,6 +49,7 @@ public:
     // this should be called when viewport dimensions change
     // i.e. when window size changes
     void setViewport(int width, int height);
+    glm::vec2 getViewportSize() const { return glm::vec2(m_viewportWidth, m_viewportHeight); }
 
 private:
     glm::vec3 m_worldUp;
@@ -0,0 +1,232 @@
+#include "CommandBuffer.h"
+
+void CommandBuffer::bufferData(unsigned int buffer, size_t size, GLenum usage) {
+	push(Op::BufferData, BufferArgs{ buffer, usage, 0, size });
+}
+
+void CommandBuffer::bufferSubData(unsigned int buffer, size_t offset, const void* data, size_t size) {
+	if (size == 0) return;
+
+	BufferArgs args = { buffer, 0, offset, size };
+	unsigned char* dst = append(Op::BufferSubData, sizeof(BufferArgs) + size);
+	std::memcpy(dst, &args, sizeof(args));
+	std::memcpy(dst + sizeof(args), data, size);
+}
+
+void CommandBuffer::uniform1iv(int location, const int* values, int count) {
+	if (location < 0 || count <= 0) return;
+
+	glm::ivec2 args(location, count);
+	unsigned char* dst = append(Op::Uniform1iv, sizeof(args) + count * sizeof(int));
+	std::memcpy(dst, &args, sizeof(args));
+	std::memcpy(dst + sizeof(args), values, count * sizeof(int));
+}
+
+// copy a payload out of the stream
+template<typename T>
+static T read(const unsigned char* at) {
+	T value;
+	std::memcpy(&value, at, sizeof(T));
+	return value;
+}
+
+void CommandBuffer::execute() const {
+	const unsigned char* at = bytes.data();
+	const unsigned char* end = at + bytes.size();
+
+	while (at < end) {
+		Op op = static_cast<Op>(at[0]);
+		uint32_t payloadSize = read<uint32_t>(at + 4);
+		const unsigned char* payload = at + ALIGN;
+		at = payload + align(payloadSize);
+
+		switch (op) {
+		case Op::BindFramebuffer: {
+			auto args = read<Target>(payload);
+			glBindFramebuffer(args.target, args.name);
+			break;
+		}
+		case Op::Viewport: {
+			auto v = read<glm::ivec4>(payload);
+			glViewport(v.x, v.y, v.z, v.w);
+			break;
+		}
+		case Op::ClearColor: {
+			auto c = read<glm::vec4>(payload);
+			glClearColor(c.r, c.g, c.b, c.a);
+			break;
+		}
+		case Op::Clear:
+			glClear(read<GLbitfield>(payload));
+			break;
+		case Op::ClearBuffer: {
+			auto args = read<ClearBufferArgs>(payload);
+			glClearBufferfv(GL_COLOR, args.drawBuffer, &args.value[0]);
+			break;
+		}
+		case Op::BlitFramebuffer: {
+			auto args = read<BlitArgs>(payload);
+			glBlitFramebuffer(0, 0, args.size.x, args.size.y, 0, 0, args.size.z, args.size.w, args.mask, args.filter);
+			break;
+		}
+		case Op::Enable:
+			glEnable(read<GLenum>(payload));
+			break;
+		case Op::Disable:
+			glDisable(read<GLenum>(payload));
+			break;
+		case Op::DepthFunc:
+			glDepthFunc(read<GLenum>(payload));
+			break;
+		case Op::DepthMask:
+			glDepthMask(read<uint32_t>(payload) ? GL_TRUE : GL_FALSE);
+			break;
+		case Op::ColorMask: {
+			GLboolean write = read<uint32_t>(payload) ? GL_TRUE : GL_FALSE;
+			glColorMask(write, write, write, write);
+			break;
+		}
+		case Op::BlendFunc: {
+			auto f = read<glm::uvec2>(payload);
+			glBlendFunc(f.x, f.y);
+			break;
+		}
+		case Op::BlendFunci: {
+			auto f = read<glm::uvec3>(payload);
+			glBlendFunci(f.x, f.y, f.z);
+			break;
+		}
+		case Op::UseProgram:
+			glUseProgram(read<unsigned int>(payload));
+			break;
+		case Op::BindTexture: {
+			auto b = read<glm::uvec3>(payload);
+			glActiveTexture(GL_TEXTURE0 + b.x);
+			glBindTexture(b.y, b.z);
+			break;
+		}
+		case Op::BindBufferBase: {
+			auto b = read<glm::uvec3>(payload);
+			glBindBufferBase(b.x, b.y, b.z);
+			break;
+		}
+		case Op::BindBufferRange: {
+			auto args = read<BufferRangeArgs>(payload);
+			glBindBufferRange(args.target, args.index, args.buffer, static_cast<GLintptr>(args.offset), static_cast<GLsizeiptr>(args.size));
+			break;
+		}
+		case Op::BufferData: {
+			auto args = read<BufferArgs>(payload);
+			glNamedBufferData(args.buffer, static_cast<GLsizeiptr>(args.size), nullptr, args.usage);
+			break;
+		}
+		case Op::BufferSubData: {
+			auto args = read<BufferArgs>(payload);
+			glNamedBufferSubData(args.buffer, static_cast<GLintptr>(args.offset), static_cast<GLsizeiptr>(args.size), payload + sizeof(BufferArgs));
+			break;
+		}
+		case Op::CopyBufferSubData: {
+			auto args = read<CopyArgs>(payload);
+			glCopyNamedBufferSubData(args.src, args.dst, static_cast<GLintptr>(args.srcOffset), static_cast<GLintptr>(args.dstOffset), static_cast<GLsizeiptr>(args.size));
+			break;
+		}
+		case Op::Uniform1i: {
+			auto u = read<glm::ivec2>(payload);
+			glUniform1i(u.x, u.y);
+			break;
+		}
+		case Op::Uniform1iv: {
+			auto u = read<glm::ivec2>(payload);
+			glUniform1iv(u.x, u.y, reinterpret_cast<const GLint*>(payload + sizeof(glm::ivec2)));
+			break;
+		}
+		case Op::Uniform1f: {
+			auto u = read<UniformArgs<float>>(payload);
+			glUniform1f(u.location, u.value);
+			break;
+		}
+		case Op::Uniform2f: {
+			auto u = read<UniformArgs<glm::vec2>>(payload);
+			glUniform2fv(u.location, 1, &u.value[0]);
+			break;
+		}
+		case Op::Uniform3f: {
+			auto u = read<UniformArgs<glm::vec3>>(payload);
+			glUniform3fv(u.location, 1, &u.value[0]);
+			break;
+		}
+		case Op::Uniform4f: {
+			auto u = read<UniformArgs<glm::vec4>>(payload);
+			glUniform4fv(u.location, 1, &u.value[0]);
+			break;
+		}
+		case Op::UniformMatrix4f: {
+			auto u = read<UniformArgs<glm::mat4>>(payload);
+			glUniformMatrix4fv(u.location, 1, GL_FALSE, &u.value[0][0]);
+			break;
+		}
+		case Op::DrawElements: {
+			auto d = read<glm::uvec3>(payload);
+			glBindVertexArray(d.x);
+			if (d.z == 1) glDrawElements(GL_TRIANGLES, d.y, GL_UNSIGNED_INT, 0);
+			else glDrawElementsInstanced(GL_TRIANGLES, d.y, GL_UNSIGNED_INT, 0, d.z);
+			break;
+		}
+		case Op::DrawArrays: {
+			auto d = read<glm::uvec4>(payload);
+			glBindVertexArray(d.x);
+			glDrawArrays(d.y, d.z, d.w);
+			break;
+		}
+		case Op::BeginQuery: {
+			auto args = read<Target>(payload);
+			glBeginQuery(args.target, args.name);
+			break;
+		}
+		case Op::EndQuery:
+			glEndQuery(read<GLenum>(payload));
+			break;
+		case Op::QueryCounter:
+			glQueryCounter(read<unsigned int>(payload), GL_TIMESTAMP);
+			break;
+		case Op::QueryValue: {
+			auto args = read<QueryValueArgs>(payload);
+			*args.value = 0;
+			GLuint available = 0;
+			glGetQueryObjectuiv(args.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) break; // rather lose a sample than stall
+
+			GLuint64 value = 0;
+			glGetQueryObjectui64v(args.query, GL_QUERY_RESULT, &value);
+			*args.value = value;
+			break;
+		}
+		case Op::FenceSync: {
+			GLsync* slot = read<GLsync*>(payload);
+			if (*slot) glDeleteSync(*slot);
+			*slot = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			break;
+		}
+		case Op::WaitSync: {
+			GLsync* slot = read<GLsync*>(payload);
+			if (!*slot) break;
+
+			// flush on the first try so the fence is guaranteed to signal eventually
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			while (glClientWaitSync(*slot, flags, 1000000) == GL_TIMEOUT_EXPIRED) {
+				flags = 0;
+			}
+			glDeleteSync(*slot);
+			*slot = nullptr;
+			break;
+		}
+		case Op::Callback: {
+			auto args = read<CallbackArgs>(payload);
+			args.fn(args.userData);
+			break;
+		}
+		}
+	}
+
+	glBindVertexArray(0);
+}
\ No newline at end of file
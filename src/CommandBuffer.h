@@ -0,0 +1,160 @@
+// A recorded stream of GL commands, replayed later by whichever thread owns the context
+// Recording never touches GL, so it can happen on the main thread while the render thread is busy
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+class CommandBuffer {
+public:
+	// commands are packed back to back as [Op][payload], with uniform values and buffer uploads copied inline
+	// so nothing recorded points back into CPU state that may change before the replay
+	enum class Op : uint8_t {
+		BindFramebuffer,
+		Viewport,
+		ClearColor,
+		Clear,
+		ClearBuffer,
+		BlitFramebuffer,
+		Enable,
+		Disable,
+		DepthFunc,
+		DepthMask,
+		ColorMask,
+		BlendFunc,
+		BlendFunci,
+		UseProgram,
+		BindTexture,
+		BindBufferBase,
+		BindBufferRange,
+		BufferData,
+		BufferSubData,
+		CopyBufferSubData,
+		Uniform1i,
+		Uniform1iv,
+		Uniform1f,
+		Uniform2f,
+		Uniform3f,
+		Uniform4f,
+		UniformMatrix4f,
+		DrawElements,
+		DrawArrays,
+		BeginQuery,
+		EndQuery,
+		QueryCounter,
+		QueryValue,
+		FenceSync,
+		WaitSync,
+		Callback,
+	};
+
+	// drop the recorded commands but keep the memory, so a warmed up buffer never allocates
+	void reset() { bytes.clear(); commandCount = 0; }
+	bool empty() const { return commandCount == 0; }
+	size_t size() const { return commandCount; }
+	size_t sizeBytes() const { return bytes.size(); }
+
+	// framebuffer state
+	void bindFramebuffer(GLenum target, unsigned int fbo) { push(Op::BindFramebuffer, Target{ target, fbo }); }
+	void viewport(int x, int y, int width, int height) { push(Op::Viewport, glm::ivec4(x, y, width, height)); }
+	void clearColor(const glm::vec4& color) { push(Op::ClearColor, color); }
+	void clear(GLbitfield mask) { push(Op::Clear, mask); }
+	void clearBuffer(int drawBuffer, const glm::vec4& value) { push(Op::ClearBuffer, ClearBufferArgs{ drawBuffer, value }); }
+	void blitFramebuffer(int srcWidth, int srcHeight, int dstWidth, int dstHeight, GLbitfield mask, GLenum filter) {
+		push(Op::BlitFramebuffer, BlitArgs{ glm::ivec4(srcWidth, srcHeight, dstWidth, dstHeight), mask, filter });
+	}
+
+	// fixed function state
+	void enable(GLenum cap) { push(Op::Enable, cap); }
+	void disable(GLenum cap) { push(Op::Disable, cap); }
+	void depthFunc(GLenum func) { push(Op::DepthFunc, func); }
+	void depthMask(bool write) { push(Op::DepthMask, static_cast<uint32_t>(write)); }
+	void colorMask(bool write) { push(Op::ColorMask, static_cast<uint32_t>(write)); }
+	void blendFunc(GLenum src, GLenum dst) { push(Op::BlendFunc, glm::uvec2(src, dst)); }
+	void blendFunci(unsigned int buffer, GLenum src, GLenum dst) { push(Op::BlendFunci, glm::uvec3(buffer, src, dst)); }
+
+	// bindings
+	void useProgram(unsigned int program) { push(Op::UseProgram, program); }
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture) { push(Op::BindTexture, glm::uvec3(unit, target, texture)); }
+	void bindBufferBase(GLenum target, unsigned int index, unsigned int buffer) { push(Op::BindBufferBase, glm::uvec3(target, index, buffer)); }
+	void bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, size_t offset, size_t size) { push(Op::BindBufferRange, BufferRangeArgs{ target, index, buffer, offset, size }); }
+
+	// buffers, bufferData (re)allocates without contents, bufferSubData copies data into the stream
+	void bufferData(unsigned int buffer, size_t size, GLenum usage);
+	void bufferSubData(unsigned int buffer, size_t offset, const void* data, size_t size);
+	// GPU side copy, used to move data staged in a mapped buffer into its destination
+	void copyBufferSubData(unsigned int src, unsigned int dst, size_t srcOffset, size_t dstOffset, size_t size) {
+		if (size) push(Op::CopyBufferSubData, CopyArgs{ src, dst, srcOffset, dstOffset, size });
+	}
+
+	// uniforms, location -1 is recorded as nothing, same as GL ignoring it
+	void uniform1i(int location, int v) { if (location >= 0) push(Op::Uniform1i, glm::ivec2(location, v)); }
+	void uniform1iv(int location, const int* values, int count);
+	void uniform1f(int location, float v) { if (location >= 0) push(Op::Uniform1f, UniformArgs<float>{ location, v }); }
+	void uniform2f(int location, const glm::vec2& v) { if (location >= 0) push(Op::Uniform2f, UniformArgs<glm::vec2>{ location, v }); }
+	void uniform3f(int location, const glm::vec3& v) { if (location >= 0) push(Op::Uniform3f, UniformArgs<glm::vec3>{ location, v }); }
+	void uniform4f(int location, const glm::vec4& v) { if (location >= 0) push(Op::Uniform4f, UniformArgs<glm::vec4>{ location, v }); }
+	void uniformMatrix4f(int location, const glm::mat4& m) { if (location >= 0) push(Op::UniformMatrix4f, UniformArgs<glm::mat4>{ location, m }); }
+
+	// draws, always indexed triangles for meshes
+	void drawElements(unsigned int vao, int indexCount, int instanceCount = 1) { push(Op::DrawElements, glm::uvec3(vao, indexCount, instanceCount)); }
+	void drawArrays(unsigned int vao, GLenum mode, int first, int count) { push(Op::DrawArrays, glm::uvec4(vao, mode, first, count)); }
+
+	// queries
+	void beginQuery(GLenum target, unsigned int query) { push(Op::BeginQuery, Target{ target, query }); }
+	void endQuery(GLenum target) { push(Op::EndQuery, target); }
+	// record the GPU time once everything before it has finished (GL_TIMESTAMP)
+	void queryCounter(unsigned int query) { push(Op::QueryCounter, query); }
+	// write the result of a query to *value on the GL thread, 0 if it is not available yet (never stalls)
+	void queryValue(unsigned int query, uint64_t* value) { push(Op::QueryValue, QueryValueArgs{ query, value }); }
+
+	// fences, the GLsync lives at *slot which only the replaying thread touches
+	// fenceSync replaces (and deletes) the fence in the slot, waitSync blocks until it signals and clears the slot
+	void fenceSync(GLsync* slot) { push(Op::FenceSync, slot); }
+	void waitSync(GLsync* slot) { push(Op::WaitSync, slot); }
+
+	// escape hatch for work that doesn't fit the command set (e.g. the gui backend)
+	// fn runs on the GL thread, userData must stay alive until the buffer has been replayed
+	void callback(void (*fn)(void*), void* userData) { push(Op::Callback, CallbackArgs{ fn, userData }); }
+
+	// replay everything in order, must be called with the context current
+	void execute() const;
+
+private:
+	struct Target { GLenum target; unsigned int name; };
+	struct ClearBufferArgs { int drawBuffer; glm::vec4 value; };
+	struct BlitArgs { glm::ivec4 size; GLbitfield mask; GLenum filter; }; // src width/height, dst width/height
+	template<typename T> struct UniformArgs { int location; T value; };
+	struct BufferRangeArgs { GLenum target; unsigned int index; unsigned int buffer; uint64_t offset; uint64_t size; };
+	struct BufferArgs { unsigned int buffer; uint32_t usage; uint64_t offset; uint64_t size; };
+	struct CopyArgs { unsigned int src; unsigned int dst; uint64_t srcOffset; uint64_t dstOffset; uint64_t size; };
+	struct QueryValueArgs { unsigned int query; uint64_t* value; };
+	struct CallbackArgs { void (*fn)(void*); void* userData; };
+
+	std::vector<unsigned char> bytes;
+	size_t commandCount = 0;
+
+	// payloads are kept 8 byte aligned so replay can read them in place
+	static constexpr size_t ALIGN = 8;
+	static constexpr size_t align(size_t size) { return (size + ALIGN - 1) & ~(ALIGN - 1); }
+
+	// reserve an op header plus payloadSize bytes, returns where the payload goes
+	unsigned char* append(Op op, size_t payloadSize) {
+		size_t at = bytes.size();
+		bytes.resize(at + ALIGN + align(payloadSize));
+		bytes[at] = static_cast<unsigned char>(op);
+		uint32_t size32 = static_cast<uint32_t>(payloadSize);
+		std::memcpy(&bytes[at + 4], &size32, sizeof(size32));
+		commandCount++;
+		return &bytes[at + ALIGN];
+	}
+
+	template<typename T>
+	void push(Op op, const T& payload) {
+		std::memcpy(append(op, sizeof(T)), &payload, sizeof(T));
+	}
+};
\ No newline at end of file
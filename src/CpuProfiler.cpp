@@ -0,0 +1,136 @@
+#include "CpuProfiler.h"
+
+#include <logger.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+namespace {
+	const auto epoch = std::chrono::steady_clock::now();
+
+	thread_local const char* t_ThreadName = nullptr;
+
+	void writeEscaped(std::ostream& out, const char* text) {
+		for (const char* c = text; *c; c++) {
+			if (*c == '"' || *c == '\\') out << '\\';
+			out << *c;
+		}
+	}
+}
+
+int64_t CpuProfiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void CpuProfiler::setThreadName(const char* name) {
+	t_ThreadName = name;
+}
+
+CpuProfiler::ThreadBuffer& CpuProfiler::threadBuffer() {
+	thread_local ThreadBuffer* buffer = nullptr;
+	if (buffer) return *buffer;
+
+	// first zone on this thread
+	CpuProfiler& profiler = instance();
+	std::lock_guard<std::mutex> lock(profiler.mtx);
+	profiler.buffers.push_back(std::make_unique<ThreadBuffer>());
+	buffer = profiler.buffers.back().get();
+	buffer->name = t_ThreadName ? t_ThreadName : "Thread " + std::to_string(profiler.buffers.size() - 1);
+	return *buffer;
+}
+
+void CpuProfiler::Zone::begin(const char* name) {
+	zoneName = name;
+	threadBuffer().depth++;
+	start = now();
+}
+
+void CpuProfiler::Zone::end() {
+	int64_t stop = now();
+	ThreadBuffer& buffer = threadBuffer();
+	buffer.depth--;
+
+	uint64_t head = buffer.head.load(std::memory_order_relaxed);
+	buffer.events[head & (RING_SIZE - 1)] = { zoneName, start, stop, buffer.depth };
+	buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::readEvents(const ThreadBuffer& buffer, int64_t after, std::vector<Event>& out) {
+	size_t first = out.size();
+	uint64_t head = buffer.head.load(std::memory_order_acquire);
+	uint64_t oldest = head > RING_SIZE ? head - RING_SIZE : 0;
+
+	// events are written when a zone ends, so walking back from head goes back in end time
+	uint64_t i = head;
+	while (i > oldest && buffer.events[(i - 1) & (RING_SIZE - 1)].end > after) i--;
+	for (uint64_t j = i; j < head; j++) out.push_back(buffer.events[j & (RING_SIZE - 1)]);
+
+	// anything the writer lapped while we copied is garbage
+	uint64_t newHead = buffer.head.load(std::memory_order_acquire);
+	uint64_t valid = newHead > RING_SIZE ? newHead - RING_SIZE : 0;
+	if (valid > i) out.erase(out.begin() + first, out.begin() + first + static_cast<size_t>(std::min(valid, head) - i));
+}
+
+void CpuProfiler::endFrame() {
+	int64_t frameEnd = now();
+	frameTime = (frameEnd - frameStart) / 1000000.0f;
+
+	frameEvents.clear();
+	if (enabled()) {
+		std::lock_guard<std::mutex> lock(mtx);
+		for (size_t thread = 0; thread < buffers.size(); thread++) {
+			scratch.clear();
+			readEvents(*buffers[thread], frameStart, scratch);
+
+			// parents end after their children, start order puts them first again
+			std::stable_sort(scratch.begin(), scratch.end(), [](const Event& a, const Event& b) {
+				return a.start != b.start ? a.start < b.start : a.depth < b.depth;
+			});
+			for (const Event& event : scratch) frameEvents.push_back({ event, static_cast<int>(thread) });
+		}
+	}
+	frameStart = frameEnd;
+}
+
+void CpuProfiler::threadNames(std::vector<std::string>& out) const {
+	std::lock_guard<std::mutex> lock(mtx);
+	out.resize(buffers.size());
+	for (size_t i = 0; i < buffers.size(); i++) out[i] = buffers[i]->name;
+}
+
+void CpuProfiler::writeTraceEvents(std::ostream& out, int64_t after, bool& first) const {
+	std::lock_guard<std::mutex> lock(mtx);
+	std::vector<Event> events;
+	for (size_t thread = 0; thread < buffers.size(); thread++) {
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":\"";
+		writeEscaped(out, buffers[thread]->name.c_str());
+		out << "\"}}";
+		first = false;
+
+		// timestamps are in microseconds
+		events.clear();
+		readEvents(*buffers[thread], after, events);
+		for (const Event& event : events) {
+			out << ",\n{\"name\":\"";
+			writeEscaped(out, event.name);
+			out << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+				<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+		}
+	}
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string& path) const {
+	std::ofstream out(path);
+	if (!out) {
+		logger.error("failed to write trace: " + path);
+		return false;
+	}
+
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	writeTraceEvents(out, -1, first);
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	logger.info("wrote CPU trace to " + path);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+// Instrumented CPU profiler, zones are placed with PROFILE_ZONE / PROFILE_FUNCTION
+// Every thread records finished zones into its own ring, so recording never locks
+// The last frame is shown as a tree in the gui and the rings can be saved as a Chrome trace (chrome://tracing, Perfetto)
+//
+// Built with KESTREL_PROFILER=0 the macros compile to nothing, otherwise a disabled profiler costs one relaxed load per zone
+#pragma once
+
+#ifndef KESTREL_PROFILER
+#define KESTREL_PROFILER 1
+#endif
+
+#include <atomic>
+#include <ostream>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class CpuProfiler {
+public:
+	static constexpr uint32_t RING_SIZE = 16384; // zones kept per thread, power of two
+
+	struct Event {
+		const char* name; // must outlive the profiler, zones use literals and __func__
+		int64_t start;	  // ns since the profiler was created
+		int64_t end;
+		uint32_t depth;	  // zones open on the thread when this one started
+	};
+
+	// a zone of the last frame, thread is an index into threadNames()
+	struct FrameEvent {
+		Event event;
+		int thread;
+	};
+
+	static CpuProfiler& instance() {
+		static CpuProfiler profiler;
+		return profiler;
+	}
+
+	// off by default, switching it on or off mid-zone is fine
+	static bool enabled() { return s_Enabled.load(std::memory_order_relaxed); }
+	static void setEnabled(bool enabled) { s_Enabled.store(enabled, std::memory_order_relaxed); }
+
+	// names the calling thread in the gui and the trace, call before its first zone
+	static void setThreadName(const char* name);
+
+	// call once per frame on the main thread, gathers every zone that ended since the last call
+	void endFrame();
+	const std::vector<FrameEvent>& lastFrame() const { return frameEvents; } // per thread, in start order
+	float lastFrameTime() const { return frameTime; }
+	void threadNames(std::vector<std::string>& out) const; // reuses out's storage
+
+	// write everything still in the rings as trace_event JSON
+	bool writeChromeTrace(const std::string& path) const;
+
+	// the trace_event objects alone, for zones that ended after `after` (ns, see now())
+	// comma separated, first says whether anything was written before them
+	void writeTraceEvents(std::ostream& out, int64_t after, bool& first) const;
+
+	static int64_t now();
+
+	// RAII zone, use the macros
+	class Zone {
+	public:
+		explicit Zone(const char* name) {
+			if (!enabled()) return;
+			begin(name);
+		}
+		~Zone() {
+			if (zoneName) end();
+		}
+
+	private:
+		const char* zoneName = nullptr;
+		int64_t start = 0;
+
+		void begin(const char* name);
+		void end();
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+	};
+
+private:
+	// single producer ring, the owning thread writes and publishes head, readers copy and then
+	// drop whatever the writer may have overwritten meanwhile
+	struct ThreadBuffer {
+		Event events[RING_SIZE];
+		std::atomic<uint64_t> head{ 0 };
+		uint32_t depth = 0;
+		std::string name;
+	};
+
+	CpuProfiler() = default;
+
+	// prevent copying
+	CpuProfiler(const CpuProfiler&) = delete;
+	CpuProfiler& operator=(const CpuProfiler&) = delete;
+
+	static inline std::atomic<bool> s_Enabled{ false };
+
+	static ThreadBuffer& threadBuffer();
+
+	// copy the events of one ring that ended after `after`, oldest first
+	static void readEvents(const ThreadBuffer& buffer, int64_t after, std::vector<Event>& out);
+
+	// buffers are created on a thread's first zone and live as long as the profiler
+	mutable std::mutex mtx;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+	int64_t frameStart = 0;
+	float frameTime = 0.0f;
+	std::vector<FrameEvent> frameEvents;
+	std::vector<Event> scratch;
+};
+
+// declare global
+inline CpuProfiler& cpuProfiler = CpuProfiler::instance();
+
+#if KESTREL_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) CpuProfiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#endif
\ No newline at end of file
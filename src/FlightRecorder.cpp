@@ -0,0 +1,78 @@
+#include "FlightRecorder.h"
+#include "CpuProfiler.h"
+
+#include <logger.h>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+
+void FlightRecorder::arm(bool enable) {
+	isArmed = enable;
+	if (enable) CpuProfiler::setEnabled(true);
+}
+
+bool FlightRecorder::endFrame(float frameMs, const RenderStats::Frame& counters) {
+	int64_t end = CpuProfiler::now();
+	int64_t start = lastEnd >= 0 ? lastEnd : end - static_cast<int64_t>(frameMs * 1000000.0f);
+	lastEnd = end;
+
+	frames[frameCount % FRAMES] = { frameCount, start, end, frameMs, counters };
+	frameCount++;
+
+	if (!isArmed || frameMs <= thresholdMs) return false;
+	if (frameCount <= static_cast<uint64_t>(ignoreFirstFrames) || captures >= maxCaptures) return false;
+	if (captures > 0 && (end - lastCaptureTime) / 1e9 < cooldown) return false;
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	std::string path = directory + "/hitch_" + std::to_string(frameCount - 1) + ".json";
+	if (!write(path)) return false;
+
+	// the capture itself took a while, don't let it count against the next frame
+	lastCaptureTime = CpuProfiler::now();
+	captures++;
+	lastCapturePath = path;
+	logger.warning("hitch: frame " + std::to_string(frameCount - 1) + " took " + std::to_string(frameMs) + " ms, captured to " + path);
+	return true;
+}
+
+bool FlightRecorder::write(const std::string& path) const {
+	std::ofstream out(path);
+	if (!out) {
+		logger.error("failed to write hitch capture: " + path);
+		return false;
+	}
+
+	uint64_t count = std::min<uint64_t>(frameCount, FRAMES);
+	const FrameRecord& oldest = frames[(frameCount - count) % FRAMES];
+	const FrameRecord& hitch = frames[(frameCount - 1) % FRAMES];
+
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	cpuProfiler.writeTraceEvents(out, oldest.start, first);
+
+	// frames on their own track, counters as counter tracks, times in microseconds
+	const int framesTid = 1000;
+	out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << framesTid << ",\"args\":{\"name\":\"Frames\"}}";
+	for (uint64_t i = frameCount - count; i < frameCount; i++) {
+		const FrameRecord& f = frames[i % FRAMES];
+		bool isHitch = &f == &hitch;
+
+		out << ",\n{\"name\":\"" << (isHitch ? "HITCH " : "") << "Frame " << f.frame << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":" << framesTid
+			<< ",\"ts\":" << f.start / 1000.0 << ",\"dur\":" << (f.end - f.start) / 1000.0;
+		if (isHitch) out << ",\"cname\":\"terrible\"";
+		out << ",\"args\":{\"ms\":" << f.ms;
+		for (int c = 0; c < RenderStats::COUNT; c++) out << ",\"" << RenderStats::name(c) << "\":" << f.counters[c];
+		out << "}}";
+
+		out << ",\n{\"name\":\"Render Stats\",\"ph\":\"C\",\"pid\":1,\"ts\":" << f.start / 1000.0 << ",\"args\":{\"Draw calls\":" << f.counters[RenderStats::DrawCalls]
+			<< ",\"Shader switches\":" << f.counters[RenderStats::ShaderSwitches] << ",\"Texture binds\":" << f.counters[RenderStats::TextureBinds] << "}}";
+	}
+
+	// a global marker so the slow frame is easy to find when zoomed out
+	out << ",\n{\"name\":\"hitch\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":" << framesTid << ",\"ts\":" << hitch.start / 1000.0
+		<< ",\"args\":{\"frame\":" << hitch.frame << ",\"ms\":" << hitch.ms << ",\"threshold_ms\":" << thresholdMs << "}}";
+
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return static_cast<bool>(out);
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+// Keeps the last FRAMES frames (timings and render counters) and, when a frame takes longer than the threshold,
+// writes them together with the CPU zones of that stretch as a Chrome trace, the slow frame marked
+// Zones come from CpuProfiler, so recording is switched on while the recorder is armed
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "RenderStats.h"
+
+class FlightRecorder {
+public:
+	static constexpr int FRAMES = 120;
+
+	float thresholdMs = 50.0f;
+	float cooldown = 10.0f;				// s, writing a capture is slow enough to cause the next hitch
+	int maxCaptures = 16;				// per run
+	int ignoreFirstFrames = 30;			// startup and the first frames are always slow
+	std::string directory = "hitches";	// captures go to <directory>/hitch_<frame>.json
+
+	bool armed() const { return isArmed; }
+	void arm(bool enable);
+
+	// once per frame on the main thread, for the frame that just ended
+	// returns true if it was a hitch and got captured
+	bool endFrame(float frameMs, const RenderStats::Frame& counters);
+
+	int captureCount() const { return captures; }
+	const std::string& lastCapture() const { return lastCapturePath; }
+
+private:
+	struct FrameRecord {
+		uint64_t frame;
+		int64_t start; // ns, CpuProfiler::now()
+		int64_t end;
+		float ms;
+		RenderStats::Frame counters;
+	};
+
+	FrameRecord frames[FRAMES] = {};
+	uint64_t frameCount = 0;
+	int64_t lastEnd = -1;
+	int64_t lastCaptureTime = 0;
+
+	bool isArmed = false;
+	int captures = 0;
+	std::string lastCapturePath;
+
+	bool write(const std::string& path) const;
+};
\ No newline at end of file
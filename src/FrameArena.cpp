@@ -0,0 +1,59 @@
+#include "FrameArena.h"
+
+#include <threadpool.h>
+#include <algorithm>
+
+void* LinearArena::allocateSlow(size_t size, size_t alignment) {
+	if (!blocks.empty()) usedBefore += top - reinterpret_cast<uintptr_t>(blocks.back().data.get());
+
+	// at least double, so a growing frame needs few blocks before the next reset merges them
+	size_t blockSize = std::max({ MIN_BLOCK_SIZE, capacity(), size + alignment });
+	blocks.push_back({ std::make_unique<unsigned char[]>(blockSize), blockSize });
+
+	top = reinterpret_cast<uintptr_t>(blocks.back().data.get());
+	end = top + blockSize;
+	return allocate(size, alignment);
+}
+
+void LinearArena::reset() {
+	peakUsed = std::max(peakUsed, used());
+
+	if (blocks.size() > 1) {
+		size_t total = capacity();
+		blocks.clear();
+		blocks.push_back({ std::make_unique<unsigned char[]>(total), total });
+	}
+
+	usedBefore = 0;
+	top = blocks.empty() ? 0 : reinterpret_cast<uintptr_t>(blocks.back().data.get());
+	end = blocks.empty() ? 0 : top + blocks.back().size;
+}
+
+size_t LinearArena::used() const {
+	if (blocks.empty()) return 0;
+	return usedBefore + (top - reinterpret_cast<uintptr_t>(blocks.back().data.get()));
+}
+
+size_t LinearArena::capacity() const {
+	size_t total = 0;
+	for (const auto& block : blocks) total += block.size;
+	return total;
+}
+
+FrameArena::FrameArena() : arenas(1 + threadPool.size()) {}
+
+void FrameArena::reset() {
+	for (auto& arena : arenas) arena.reset();
+}
+
+size_t FrameArena::used() const {
+	size_t total = 0;
+	for (const auto& arena : arenas) total += arena.used();
+	return total;
+}
+
+size_t FrameArena::capacity() const {
+	size_t total = 0;
+	for (const auto& arena : arenas) total += arena.capacity();
+	return total;
+}
\ No newline at end of file
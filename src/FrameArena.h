@@ -0,0 +1,95 @@
+// Linear (bump) allocators for data that only lives for one frame: culling output, sort scratch, light binning
+// Allocating bumps a pointer, freeing does nothing, reset() drops everything at once
+// Blocks are kept across resets, so once an arena has grown to what a frame needs it never touches the heap
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// single threaded, cache line aligned so neighbouring arenas used by different threads don't share a line
+class alignas(64) LinearArena {
+public:
+	static constexpr size_t MIN_BLOCK_SIZE = 64 << 10;
+
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+		uintptr_t at = (top + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+		if (at + size > end || !top) return allocateSlow(size, alignment);
+		top = at + size;
+		return reinterpret_cast<void*>(at);
+	}
+
+	template<typename T>
+	T* allocate(size_t count) { return static_cast<T*>(allocate(count * sizeof(T), alignof(T))); }
+
+	// only the most recent allocation is actually given back, the rest waits for reset()
+	void deallocate(void* p, size_t size) {
+		if (reinterpret_cast<uintptr_t>(p) + size == top) top = reinterpret_cast<uintptr_t>(p);
+	}
+
+	// forget every allocation, what was handed out must not be used anymore
+	// a frame that overflowed into more blocks leaves one block big enough for all of them
+	void reset();
+
+	size_t used() const;		// bytes since the last reset, alignment padding included
+	size_t capacity() const;	// bytes in all blocks
+	size_t peak() const { return peakUsed; } // most used between two resets
+
+private:
+	struct Block {
+		std::unique_ptr<unsigned char[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks; // the last one is being bumped
+	uintptr_t top = 0;
+	uintptr_t end = 0;
+	size_t usedBefore = 0; // by the blocks before the last one
+	size_t peakUsed = 0;
+
+	void* allocateSlow(size_t size, size_t alignment);
+};
+
+// one arena for the thread that prepares the frame plus one per thread pool chunk,
+// so parallelFor bodies can allocate without locking
+class FrameArena {
+public:
+	FrameArena();
+
+	LinearArena& shared() { return arenas[0]; }
+	LinearArena& worker(unsigned int chunk) { return arenas[1 + chunk]; } // chunk as passed by ThreadPool::parallelFor
+
+	// once per frame, when nothing allocated from the arenas is referenced anymore
+	void reset();
+
+	size_t used() const;
+	size_t capacity() const;
+
+private:
+	std::vector<LinearArena> arenas;
+};
+
+// STL allocator on a LinearArena, containers using it must be gone before the arena is reset
+template<typename T>
+class ArenaAllocator {
+public:
+	using value_type = T;
+
+	explicit ArenaAllocator(LinearArena& arena) : arena(&arena) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t n) { return arena->allocate<T>(n); }
+	void deallocate(T* p, size_t n) { arena->deallocate(p, n * sizeof(T)); }
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+	LinearArena* arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
\ No newline at end of file
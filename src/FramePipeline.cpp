@@ -0,0 +1,66 @@
+#include "FramePipeline.h"
+#include "HardwareCounters.h"
+#include "AllocationTracker.h"
+
+FramePipeline::~FramePipeline() {
+	stop();
+}
+
+void FramePipeline::start(std::function<void(float)> fn) {
+	if (running) return;
+
+	job = std::move(fn);
+	running = true;
+	worker = std::thread(&FramePipeline::workerLoop, this);
+}
+
+void FramePipeline::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (!running) return;
+		running = false;
+	}
+	cv.notify_all();
+	if (worker.joinable()) worker.join();
+}
+
+void FramePipeline::kick(float deltaTime) {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		pendingDelta = deltaTime;
+		pending = true;
+	}
+	cv.notify_all();
+}
+
+void FramePipeline::wait() {
+	std::unique_lock<std::mutex> lock(mtx);
+	cv.wait(lock, [this] { return !pending; });
+}
+
+void FramePipeline::workerLoop() {
+	CpuProfiler::setThreadName("Frame Pipeline");
+	HardwareCounters::registerThread();
+	AllocationTracker::setThreadName("Frame Pipeline");
+
+	for (;;) {
+		float dt;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait(lock, [this] { return pending || !running; });
+			if (!running) return;
+			dt = pendingDelta;
+		}
+
+		{
+			PROFILE_ZONE("FramePipeline::job");
+			job(dt);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			pending = false;
+		}
+		cv.notify_all();
+	}
+}
\ No newline at end of file
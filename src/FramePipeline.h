@@ -0,0 +1,41 @@
+// Runs the per-frame CPU work (scene update + draw list building) on its own thread
+// so it overlaps with GL submission of the previous frame on the main thread
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class FramePipeline {
+public:
+	FramePipeline() = default;
+	~FramePipeline();
+
+	// spawn the worker, job receives the delta time passed to kick()
+	void start(std::function<void(float)> job);
+	void stop();
+
+	// run the job once on the worker, returns immediately
+	void kick(float deltaTime);
+
+	// block until the last kicked job has finished
+	// anything the job reads may only be modified after this returns
+	void wait();
+
+private:
+	std::thread worker;
+	std::mutex mtx;
+	std::condition_variable cv;
+
+	std::function<void(float)> job;
+	float pendingDelta = 0.0f;
+	bool pending = false;	// kicked, not yet finished
+	bool running = false;
+
+	void workerLoop();
+
+	// prevent copying
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+};
\ No newline at end of file
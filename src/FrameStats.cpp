@@ -0,0 +1,144 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+int FrameStats::Histogram::bucketOf(float ms) {
+	float us = std::min(std::max(ms * 1000.0f, 0.0f), static_cast<float>((1 << 24) - 1));
+	uint32_t value = static_cast<uint32_t>(us);
+	if (value < SUB_BUCKETS) return static_cast<int>(value); // first octave is linear
+
+	// value is in [2^e, 2^(e+1)), the top SUB_BUCKET_BITS below the leading bit pick the sub bucket
+	int exponent;
+	std::frexp(static_cast<float>(value), &exponent);
+	exponent -= 1;
+	int shift = exponent - SUB_BUCKET_BITS;
+	int octave = shift + 1;
+	int sub = static_cast<int>(value >> shift) - SUB_BUCKETS;
+	return octave * SUB_BUCKETS + sub;
+}
+
+float FrameStats::Histogram::bucketValue(int bucket) {
+	int octave = bucket / SUB_BUCKETS;
+	int sub = bucket % SUB_BUCKETS;
+	if (octave == 0) return (sub + 0.5f) / 1000.0f;
+
+	int shift = octave - 1;
+	float low = static_cast<float>((SUB_BUCKETS + sub) << shift);
+	float width = static_cast<float>(1 << shift);
+	return (low + 0.5f * width) / 1000.0f;
+}
+
+void FrameStats::Histogram::add(float ms) {
+	buckets[bucketOf(ms)]++;
+	total++;
+}
+
+void FrameStats::Histogram::remove(float ms) {
+	int bucket = bucketOf(ms);
+	if (buckets[bucket] == 0) return;
+	buckets[bucket]--;
+	total--;
+}
+
+void FrameStats::Histogram::clear() {
+	std::fill(std::begin(buckets), std::end(buckets), 0u);
+	total = 0;
+}
+
+float FrameStats::Histogram::percentile(double fraction) const {
+	if (total == 0) return 0.0f;
+
+	uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * total)));
+	uint64_t seen = 0;
+	for (int bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+		seen += buckets[bucket];
+		if (seen >= rank) return bucketValue(bucket);
+	}
+	return bucketValue(BUCKET_COUNT - 1);
+}
+
+float FrameStats::Histogram::worstMean(double fraction) const {
+	if (total == 0) return 0.0f;
+
+	uint64_t wanted = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * total)));
+	uint64_t taken = 0;
+	double sum = 0.0;
+	for (int bucket = BUCKET_COUNT - 1; bucket >= 0 && taken < wanted; bucket--) {
+		uint64_t n = std::min<uint64_t>(buckets[bucket], wanted - taken);
+		sum += static_cast<double>(n) * bucketValue(bucket);
+		taken += n;
+	}
+	return static_cast<float>(sum / taken);
+}
+
+FrameStats::FrameStats() {
+	samples.resize(MAX_SAMPLES);
+	endTimes.resize(MAX_SAMPLES);
+
+	addWindow("1 s", 1.0f);
+	addWindow("10 s", 10.0f);
+	referenceWindow = addWindow("60 s", 60.0f);
+	addWindow("Session", 0.0f);
+}
+
+int FrameStats::addWindow(const std::string& name, float seconds) {
+	Window window;
+	window.name = name;
+	window.seconds = seconds;
+	window.tail = head; // starts empty, whatever came before isn't in the ring for sure
+	windows.push_back(std::move(window));
+	return static_cast<int>(windows.size()) - 1;
+}
+
+void FrameStats::add(float frameMs) {
+	// the reference median moves slowly, no need to rescan it every frame once it has some samples
+	const Histogram& reference = windows[referenceWindow].histogram;
+	if (head % 30 == 0 || reference.count() < 30) {
+		hitchThreshold = std::max(hitchMinMs, hitchFactor * reference.percentile(0.5));
+	}
+
+	Sample sample = { frameMs, frameMs > hitchThreshold };
+	time += frameMs / 1000.0;
+	samples[head % MAX_SAMPLES] = sample;
+	endTimes[head % MAX_SAMPLES] = time;
+	head++;
+
+	for (auto& window : windows) {
+		window.histogram.add(sample.ms);
+		if (sample.hitch) window.hitches++;
+
+		if (window.seconds <= 0.0f) continue;
+
+		// drop frames that ended before the window, or that the ring is about to overwrite
+		while (window.tail < head &&
+			(endTimes[window.tail % MAX_SAMPLES] <= time - window.seconds || head - window.tail >= MAX_SAMPLES)) {
+			const Sample& old = samples[window.tail % MAX_SAMPLES];
+			window.histogram.remove(old.ms);
+			if (old.hitch) window.hitches--;
+			window.tail++;
+		}
+	}
+}
+
+void FrameStats::reset() {
+	for (auto& window : windows) {
+		window.histogram.clear();
+		window.hitches = 0;
+		window.tail = head;
+	}
+}
+
+FrameStats::Summary FrameStats::summary(int window) const {
+	const Window& w = windows[window];
+	Summary s;
+	s.frames = w.histogram.count();
+	s.p50 = w.histogram.percentile(0.5);
+	s.p90 = w.histogram.percentile(0.9);
+	s.p99 = w.histogram.percentile(0.99);
+	s.p999 = w.histogram.percentile(0.999);
+	float worst = w.histogram.worstMean(0.01);
+	s.low1Fps = worst > 0.0f ? 1000.0f / worst : 0.0f;
+	s.hitches = w.hitches;
+	return s;
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+// Frame time statistics over sliding windows
+// Every window keeps a log bucketed histogram (HDR histogram style, ~3% precision from 1 us to 16 s),
+// so adding a frame is O(1) and percentiles are a scan over a fixed number of buckets
+// Averages hide stutter, the percentiles, 1% lows and hitch counts are what to look at
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class FrameStats {
+public:
+	// histogram layout, values are in microseconds
+	static constexpr int SUB_BUCKET_BITS = 5;	// 32 buckets per power of two
+	static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static constexpr int OCTAVES = 24 - SUB_BUCKET_BITS + 1;	// up to 2^24 us
+	static constexpr int BUCKET_COUNT = OCTAVES * SUB_BUCKETS;
+
+	// frames kept for sliding windows out, windows longer than this many frames are cut short
+	static constexpr size_t MAX_SAMPLES = 1 << 15;
+
+	class Histogram {
+	public:
+		void add(float ms);
+		void remove(float ms);
+		void clear();
+
+		uint64_t count() const { return total; }
+
+		// the frame time (ms) below which this fraction of frames fall, 0 with no samples
+		float percentile(double fraction) const;
+
+		// mean of the slowest fraction of frames (ms), 1000 / worstMean(0.01) is the "1% low" FPS
+		float worstMean(double fraction) const;
+
+		static int bucketOf(float ms);
+		static float bucketValue(int bucket); // ms, middle of the bucket
+
+	private:
+		uint32_t buckets[BUCKET_COUNT] = {};
+		uint64_t total = 0;
+	};
+
+	struct Summary {
+		uint64_t frames = 0;
+		float p50 = 0.0f, p90 = 0.0f, p99 = 0.0f, p999 = 0.0f; // ms
+		float low1Fps = 0.0f;	// 1000 / mean of the slowest 1% of frames
+		uint64_t hitches = 0;
+	};
+
+	// a frame counts as a hitch when it takes longer than hitchFactor times the median of the 60 s window
+	// (at least hitchMinMs), decided when the frame is added
+	float hitchFactor = 2.0f;
+	float hitchMinMs = 8.0f;
+
+	// starts with 1 s, 10 s, 60 s and session windows
+	FrameStats();
+
+	// seconds = 0 is a window over everything since the last reset
+	int addWindow(const std::string& name, float seconds);
+	int windowCount() const { return static_cast<int>(windows.size()); }
+	const std::string& windowName(int window) const { return windows[window].name; }
+
+	// once per frame, ms
+	void add(float frameMs);
+	void reset();
+
+	Summary summary(int window) const;
+	const Histogram& histogram(int window) const { return windows[window].histogram; }
+
+private:
+	struct Sample {
+		float ms;
+		bool hitch;
+	};
+
+	struct Window {
+		std::string name;
+		float seconds;
+		Histogram histogram;
+		uint64_t hitches = 0;
+		uint64_t tail = 0; // oldest sample still in the window
+	};
+
+	std::vector<Window> windows;
+
+	// hitches are judged against the median of this window, refreshed every few frames
+	int referenceWindow = 0;
+	float hitchThreshold = 0.0f;
+
+	// ring of recent frames, with the time each one ended
+	std::vector<Sample> samples;
+	std::vector<double> endTimes;
+	uint64_t head = 0; // samples ever added
+	double time = 0.0; // s
+};
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "GpuProfiler.h"
+
+#include <logger.h>
+#include <algorithm>
+
+void GpuProfiler::init() {
+	glGenQueries(FRAMES * MAX_SCOPES * 2, &queries[0][0][0]);
+}
+
+void GpuProfiler::release() {
+	if (queries[0][0][0]) glDeleteQueries(FRAMES * MAX_SCOPES * 2, &queries[0][0][0]);
+	queries[0][0][0] = 0;
+}
+
+int GpuProfiler::addScope(const char* name) {
+	if (count == MAX_SCOPES) {
+		logger.error("too many GPU profiler scopes, ignoring " + std::string(name));
+		return MAX_SCOPES - 1;
+	}
+	names[count] = name;
+	return count++;
+}
+
+void GpuProfiler::beginFrame(CommandBuffer& cmd) {
+	slot = static_cast<int>(frame++ % FRAMES);
+
+	// read back the oldest set, issued FRAMES - 1 frames ago and reused next frame
+	int oldest = (slot + 1) % FRAMES;
+	for (int scope = 0; scope < count; scope++) {
+		measured[oldest][scope] = issued[oldest][scope];
+		if (!issued[oldest][scope]) continue;
+		cmd.queryValue(queries[oldest][scope][0], &readback[oldest][scope].begin);
+		cmd.queryValue(queries[oldest][scope][1], &readback[oldest][scope].end);
+		issued[oldest][scope] = false;
+	}
+
+	collectSlot = pendingSlot;
+	pendingSlot = oldest;
+}
+
+void GpuProfiler::begin(CommandBuffer& cmd, int scope) {
+	cmd.queryCounter(queries[slot][scope][0]);
+	issued[slot][scope] = true;
+}
+
+void GpuProfiler::end(CommandBuffer& cmd, int scope) {
+	cmd.queryCounter(queries[slot][scope][1]);
+}
+
+void GpuProfiler::collect() {
+	if (collectSlot < 0) return;
+
+	uint64_t first = UINT64_MAX, last = 0;
+	for (int scope = 0; scope < count; scope++) {
+		const Stamps& stamps = readback[collectSlot][scope];
+
+		// a pass that didn't run reads as 0, one whose result wasn't ready keeps its last value
+		if (!measured[collectSlot][scope]) times[scope] = 0.0f;
+		else if (stamps.begin && stamps.end >= stamps.begin) {
+			times[scope] = (stamps.end - stamps.begin) / 1000000.0f;
+			first = std::min(first, stamps.begin);
+			last = std::max(last, stamps.end);
+		}
+		histories[scope][historyIndex] = times[scope];
+	}
+	if (last > first) frameSpan = (last - first) / 1000000.0f;
+	frameSpanHistory[historyIndex] = frameSpan;
+	historyIndex = (historyIndex + 1) % HISTORY;
+
+	collectSlot = -1;
+}
\ No newline at end of file
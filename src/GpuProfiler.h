@@ -0,0 +1,63 @@
+// GPU timing of named scopes (render passes, the gui) with GL_TIMESTAMP queries
+// Timestamps are recorded into command buffers and read back FRAMES - 1 frames later, so the GPU is never waited on
+// A result that still isn't available by then is skipped and the scope keeps its last time
+#pragma once
+
+#include <cstdint>
+
+#include "CommandBuffer.h"
+
+class GpuProfiler {
+public:
+	static constexpr int FRAMES = 3;		// query sets in flight
+	static constexpr int MAX_SCOPES = 16;
+	static constexpr int HISTORY = 120;		// samples kept per scope for the graphs
+
+	// needs the context
+	void init();
+	void release();
+
+	// scopes are registered up front, the returned id is used with begin()/end()
+	int addScope(const char* name);
+	int scopeCount() const { return count; }
+	const char* scopeName(int scope) const { return names[scope]; }
+
+	// recording, no GL calls; scopes may nest or be skipped in a frame
+	// beginFrame starts a new set of queries, everything recorded until the next beginFrame lands in it
+	void beginFrame(CommandBuffer& cmd);
+	void begin(CommandBuffer& cmd, int scope);
+	void end(CommandBuffer& cmd, int scope);
+
+	// pick up the timestamps read back while the last frame was replayed
+	// call while no recorded frame is being replayed, e.g. right after RenderThread::waitIdle()
+	void collect();
+
+	// results, ms, a couple of frames behind
+	float time(int scope) const { return times[scope]; }
+	float frameTime() const { return frameSpan; } // first begin to last end
+	const float* history(int scope) const { return histories[scope]; }
+	const float* frameHistory() const { return frameSpanHistory; }
+	int historyOffset() const { return historyIndex; } // oldest sample, for ImGui::PlotLines
+
+private:
+	struct Stamps { uint64_t begin; uint64_t end; };
+
+	const char* names[MAX_SCOPES] = {};
+	int count = 0;
+
+	unsigned int queries[FRAMES][MAX_SCOPES][2] = {};
+	bool issued[FRAMES][MAX_SCOPES] = {};
+	Stamps readback[FRAMES][MAX_SCOPES] = {}; // written on the GL thread
+	bool measured[FRAMES][MAX_SCOPES] = {};   // which readback entries hold a scope that ran
+
+	uint64_t frame = 0;
+	int slot = 0;		  // queries recorded this frame
+	int pendingSlot = -1; // readback recorded this frame
+	int collectSlot = -1; // readback recorded last frame, complete once that frame was replayed
+
+	float times[MAX_SCOPES] = {};
+	float frameSpan = 0.0f;
+	float histories[MAX_SCOPES][HISTORY] = {};
+	float frameSpanHistory[HISTORY] = {};
+	int historyIndex = 0;
+};
\ No newline at end of file
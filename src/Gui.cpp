@@ -1,6 +1,31 @@
 #include "Gui.h"
 #include "App.h"
 
+#include <cstring>
+#include <cstdio>
+#include <cfloat>
+#include <cctype>
+#include <fstream>
+
+// positions, normals and uvs of a mesh as a Wavefront OBJ, the CPU copies must be resident
+static bool exportObj(const Mesh& mesh, const std::string& path) {
+    std::ofstream file(path);
+    if (!file) return false;
+
+    for (const auto& v : mesh.vertices) file << "v " << v.pos.x << " " << v.pos.y << " " << v.pos.z << "\n";
+    for (const auto& v : mesh.vertices) file << "vn " << v.normal.x << " " << v.normal.y << " " << v.normal.z << "\n";
+    for (const auto& v : mesh.vertices) file << "vt " << v.uv.x << " " << v.uv.y << "\n";
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        file << "f";
+        for (size_t k = 0; k < 3; k++) {
+            unsigned int index = mesh.indices[i + k] + 1; // OBJ counts from 1
+            file << " " << index << "/" << index << "/" << index;
+        }
+        file << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
 void Gui::init(App* appPtr, GLFWwindow* window) {
     if (active) return;
 
@@ -15,6 +40,10 @@ void Gui::init(App* appPtr, GLFWwindow* window) {
     ImGui_ImplGlfw_InitForOpenGL(window, false);
     ImGui_ImplOpenGL3_Init("#version 460");
 
+    // creates the backend's GL objects now, while the context is still current on this thread
+    // per frame it is called again on the render thread, see renderDrawSnapshot()
+    ImGui_ImplOpenGL3_NewFrame();
+
     // set size
     ImGui::SetNextWindowSize(ImVec2(200, 300));
 
@@ -26,6 +55,11 @@ void Gui::shutdown() {
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
+
+    for (auto& snapshot : drawSnapshots) {
+        for (ImDrawList* list : snapshot.lists) IM_DELETE(list);
+        snapshot.lists.clear();
+    }
     ImGui::DestroyContext();
 
     active = false;
@@ -34,18 +68,59 @@ void Gui::shutdown() {
 void Gui::beginFrame() {
     if (!active) return;
 
-    ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 }
 
-void Gui::endFrame() {
+void Gui::endFrame(CommandBuffer& cmd) {
     if (!active) return;
 
     ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-    ImGuiIO& io = ImGui::GetIO();
+    // ImGui reuses its draw lists on the next NewFrame(), which can happen before the render thread gets to this one
+    DrawSnapshot& snapshot = drawSnapshots[drawSnapshotIndex];
+    drawSnapshotIndex = (drawSnapshotIndex + 1) % 2;
+    copyDrawData(*ImGui::GetDrawData(), snapshot);
+
+    cmd.callback(&Gui::renderDrawSnapshot, &snapshot);
+}
+
+// copy into reused buffers, ImVector assignment would free and reallocate every frame
+template<typename T>
+static void copyVector(const ImVector<T>& src, ImVector<T>& dst) {
+    dst.resize(src.Size);
+    if (src.Size > 0) memcpy(dst.Data, src.Data, src.size_in_bytes());
+}
+
+void Gui::copyDrawData(const ImDrawData& src, DrawSnapshot& dst) {
+    while (dst.lists.Size < src.CmdListsCount) {
+        dst.lists.push_back(IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData()));
+    }
+
+    for (int i = 0; i < src.CmdListsCount; i++) {
+        const ImDrawList* from = src.CmdLists[i];
+        ImDrawList* to = dst.lists[i];
+        copyVector(from->CmdBuffer, to->CmdBuffer);
+        copyVector(from->IdxBuffer, to->IdxBuffer);
+        copyVector(from->VtxBuffer, to->VtxBuffer);
+        to->Flags = from->Flags;
+    }
+
+    dst.data.Valid = src.Valid;
+    dst.data.CmdListsCount = src.CmdListsCount;
+    dst.data.TotalIdxCount = src.TotalIdxCount;
+    dst.data.TotalVtxCount = src.TotalVtxCount;
+    dst.data.DisplayPos = src.DisplayPos;
+    dst.data.DisplaySize = src.DisplaySize;
+    dst.data.FramebufferScale = src.FramebufferScale;
+    dst.data.OwnerViewport = src.OwnerViewport;
+    dst.data.CmdLists.resize(src.CmdListsCount);
+    for (int i = 0; i < src.CmdListsCount; i++) dst.data.CmdLists[i] = dst.lists[i];
+}
+
+void Gui::renderDrawSnapshot(void* snapshot) {
+    ImGui_ImplOpenGL3_NewFrame();
+    ImGui_ImplOpenGL3_RenderDrawData(&static_cast<DrawSnapshot*>(snapshot)->data);
 }
 
 void Gui::draw() {
@@ -65,14 +140,9 @@ void Gui::draw() {
     frameTimeHistory[frameTimeOffset] = currentDeltaTime;
 
     movingAverage = frameTimeSum / (float)FRAME_HIST_COUNT;
+    if (framesSampled < FRAME_HIST_COUNT) framesSampled++;
     frameTimeOffset = (frameTimeOffset + 1) % FRAME_HIST_COUNT;
 
-    // optimization
-    maxFrameTime = 0.0f;
-    for (int i = 0; i < FRAME_HIST_COUNT; i++) {
-        if (frameTimeHistory[i] > maxFrameTime) maxFrameTime = frameTimeHistory[i];
-    }
-
     // find max for scaling graph
     maxFrameTime = 0.0f;
     for (int i = 0; i < FRAME_HIST_COUNT; i++) {
@@ -98,10 +168,38 @@ void Gui::draw() {
 
     ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "Max: %.1fms", maxFrameTime);
 
+    // percentiles over longer windows, the average above hides stutter
+    auto& stats = app->frameStats;
+    if (ImGui::TreeNode("Frame Time Percentiles")) {
+        if (ImGui::BeginTable("FrameStats", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+            for (const char* column : { "Window", "Frames", "p50", "p90", "p99", "p99.9", "1% low", "Hitches" }) {
+                ImGui::TableSetupColumn(column);
+            }
+            ImGui::TableHeadersRow();
+
+            for (int w = 0; w < stats.windowCount(); w++) {
+                auto s = stats.summary(w);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(stats.windowName(w).c_str());
+                ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(s.frames));
+                for (float ms : { s.p50, s.p90, s.p99, s.p999 }) {
+                    ImGui::TableNextColumn(); ImGui::Text("%.2f ms", ms);
+                }
+                ImGui::TableNextColumn(); ImGui::Text("%.0f FPS", s.low1Fps);
+                ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(s.hitches));
+            }
+            ImGui::EndTable();
+        }
+        ImGui::Text("Hitch: > %.1fx the 60 s median", stats.hitchFactor);
+        ImGui::SameLine();
+        if (ImGui::Button("Reset")) stats.reset();
+        ImGui::TreePop();
+    }
+
     ImGui::Separator();
 
     // camera data
-    auto cam = app->scene->camera;
+    const auto& cam = app->scene->camera;
     ImGui::Text("Camera Position");
     ImGui::Text("%.2fx, %.2fy, %.2fz,", cam.position.x, cam.position.y, cam.position.z);
     ImGui::Spacing();
@@ -127,6 +225,193 @@ void Gui::draw() {
 
     //app->renderer.renderMode = mode;
 
+    ImGui::Checkbox("Depth Pre-pass", &app->renderer.depthPrepass);
+    ImGui::Checkbox("Pipelined Frames", &app->pipelined); // simulate frame N+1 while frame N is submitted
+
+    static const char* transparencyModes[] = { "Sorted", "Weighted Blended OIT" };
+    int transparency = static_cast<int>(app->renderer.transparencyMode);
+    if (ImGui::Combo("Transparency", &transparency, transparencyModes, IM_ARRAYSIZE(transparencyModes))) {
+        app->renderer.transparencyMode = static_cast<Renderer::TransparencyMode>(transparency);
+    }
+
+    // adaptive quality
+    auto& governor = app->governor;
+    if (ImGui::Checkbox("Adaptive Quality", &governor.enabled) && governor.enabled) {
+        governor.apply(app->renderer);
+    }
+    if (governor.enabled) {
+        float targetFps = 1000.0f / governor.targetFrameTime;
+        if (ImGui::SliderFloat("Target FPS", &targetFps, 30.0f, 240.0f, "%.0f")) {
+            governor.targetFrameTime = 1000.0f / targetFps;
+        }
+        ImGui::Text("Quality: %s", governor.current().name);
+    }
+
+    auto& r = app->renderer;
+    int pcfTaps = 2 * r.shadowPcfRadius + 1;
+    ImGui::Text("Scale %.2f, shadows %d, PCF %dx%d, LOD bias %.1f", r.renderScale, r.shadowResolution, pcfTaps, pcfTaps, r.textureLodBias);
+
+    // camera paths for benchmark runs (--benchmark camera_path.txt)
+    if (!app->recordingPath) {
+        if (ImGui::Button("Record Camera Path")) app->startPathRecording();
+    }
+    else if (ImGui::Button("Stop Recording")) {
+        app->stopPathRecording("camera_path.txt");
+    }
+
+    ImGui::Spacing();
+
+    // GPU pass timings, bars are relative to the whole GPU frame
+    const auto& gpu = app->renderer.gpuProfiler;
+    float gpuFrame = gpu.frameTime();
+    ImGui::Text("GPU frame: %.3f ms", gpuFrame);
+    for (int pass = 0; pass < gpu.scopeCount(); pass++) {
+        char label[32];
+        std::snprintf(label, sizeof(label), "%.3f ms", gpu.time(pass));
+        ImGui::ProgressBar(gpuFrame > 0.0f ? gpu.time(pass) / gpuFrame : 0.0f, ImVec2(160.0f, 0.0f), label);
+        ImGui::SameLine();
+        ImGui::TextUnformatted(gpu.scopeName(pass));
+    }
+    if (ImGui::TreeNode("GPU History")) {
+        ImGui::PlotLines("Frame", gpu.frameHistory(), GpuProfiler::HISTORY, gpu.historyOffset(), nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 40.0f));
+        for (int pass = 0; pass < gpu.scopeCount(); pass++) {
+            ImGui::PlotLines(gpu.scopeName(pass), gpu.history(pass), GpuProfiler::HISTORY, gpu.historyOffset(), nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 40.0f));
+        }
+        ImGui::TreePop();
+    }
+
+    // recorded work of the last frame
+    const auto& counters = renderStats.lastFrame();
+    if (ImGui::TreeNodeEx("Render Stats", 0, "Render Stats: %llu draws, %llu triangles",
+        static_cast<unsigned long long>(counters[RenderStats::DrawCalls]), static_cast<unsigned long long>(counters[RenderStats::Triangles]))) {
+        for (int c = 0; c < RenderStats::COUNT; c++) {
+            ImGui::Text("%-16s %llu", RenderStats::name(c), static_cast<unsigned long long>(counters[c]));
+        }
+        ImGui::TreePop();
+    }
+
+    ImGui::Text("Clustered lights: %d (%d cluster entries)", app->renderer.clusteredLightCount, app->renderer.clusterIndexCount);
+    ImGui::Text("Stream buffer: %zu / %zu KB", app->renderer.streamBytesUsed / 1024, app->renderer.streamRegionSize() / 1024);
+    ImGui::Text("Mesh uploads: %zu KB", app->renderer.meshUploadBytes / 1024);
+    ImGui::Text("Frame arena: %zu / %zu KB", app->renderer.frameArenaUsed / 1024, app->renderer.frameArenaCapacity() / 1024);
+
+    ImGui::Spacing();
+
+    // memory, as reported by the allocation paths
+    auto total = resources.totals();
+    if (ImGui::TreeNodeEx("Memory", 0, "Memory: %.1f MB GPU, %.1f MB CPU", total.gpuBytes / (1024.0f * 1024.0f), total.cpuBytes / (1024.0f * 1024.0f))) {
+        for (int i = 0; i < static_cast<int>(ResourceRegistry::Category::COUNT); i++) {
+            auto category = static_cast<ResourceRegistry::Category>(i);
+            auto t = resources.totals(category);
+            ImGui::Text("%-16s %4d  %8.1f MB", ResourceRegistry::categoryName(category), t.count, (t.gpuBytes + t.cpuBytes) / (1024.0f * 1024.0f));
+        }
+
+        ImGui::Spacing();
+        ImGui::Text("Top consumers");
+        resources.topConsumers(topResources, 10);
+        for (const auto& entry : topResources) {
+            ImGui::BulletText("%.1f MB  %s", (entry.gpuBytes + entry.cpuBytes) / (1024.0f * 1024.0f), entry.label.c_str());
+        }
+        ImGui::TreePop();
+    }
+
+    // heap allocations of the last frame, the render path should settle at 0
+    const auto& allocs = allocationTracker.lastFrame();
+    if (ImGui::TreeNodeEx("Heap Allocations", 0, "Heap Allocations: %llu (%.1f KB) per frame",
+        static_cast<unsigned long long>(allocs.allocations), allocs.bytes / 1024.0f)) {
+        if (!AllocationTracker::available()) ImGui::TextDisabled("built with KESTREL_ALLOC_TRACKING=0");
+
+        allocationTracker.threads(allocationThreads);
+        for (const auto& thread : allocationThreads) {
+            ImGui::Text("%-16s %5llu allocs  %8.1f KB  %5llu frees", thread.name ? thread.name : "Unnamed",
+                static_cast<unsigned long long>(thread.counts.allocations), thread.counts.bytes / 1024.0f, static_cast<unsigned long long>(thread.counts.frees));
+        }
+
+        // call sites, sampled until switched off
+        bool sampling = AllocationTracker::sampling() > 0;
+        if (ImGui::Checkbox("Sample Call Sites", &sampling)) AllocationTracker::setSampling(sampling ? 1 : 0);
+        ImGui::SameLine();
+        if (ImGui::Button("Reset Sites")) allocationTracker.resetSites();
+
+        allocationTracker.sites(allocationSites);
+        for (size_t i = 0; i < allocationSites.size() && i < 10; i++) {
+            const auto& site = allocationSites[i];
+            ImGui::BulletText("%llu x, %.1f KB  %s", static_cast<unsigned long long>(site.allocations), site.bytes / 1024.0f, AllocationTracker::describe(site));
+        }
+        if (allocationTracker.droppedSamples() > 0) {
+            ImGui::TextDisabled("%llu samples dropped, site table full", static_cast<unsigned long long>(allocationTracker.droppedSamples()));
+        }
+        ImGui::TreePop();
+    }
+
+    // CPU zones of the last frame, per thread
+    if (ImGui::TreeNodeEx("CPU Profiler", 0, "CPU Profiler: %.2f ms", cpuProfiler.lastFrameTime())) {
+        bool profiling = CpuProfiler::enabled();
+        if (ImGui::Checkbox("Record Zones", &profiling)) CpuProfiler::setEnabled(profiling);
+        ImGui::SameLine();
+        if (ImGui::Button("Save Chrome Trace")) cpuProfiler.writeChromeTrace("cpu_trace.json");
+
+        // flight recorder, needs zones recorded to be useful
+        auto& recorder = app->flightRecorder;
+        bool armed = recorder.armed();
+        if (ImGui::Checkbox("Capture Hitches", &armed)) recorder.arm(armed);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(120.0f);
+        ImGui::SliderFloat("Threshold (ms)", &recorder.thresholdMs, 10.0f, 500.0f, "%.0f");
+        if (recorder.captureCount() > 0) {
+            ImGui::Text("%d captured, last: %s", recorder.captureCount(), recorder.lastCapture().c_str());
+        }
+
+        // perf_event counters, per frame over all counted threads and per counter zone
+        bool counting = HardwareCounters::enabled();
+        if (ImGui::Checkbox("Hardware Counters", &counting)) {
+            if (counting) hardwareCounters.enable();
+            else hardwareCounters.disable();
+        }
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s", hardwareCounters.status().c_str());
+        if (HardwareCounters::enabled()) {
+            const auto& hw = hardwareCounters.lastFrame();
+            ImGui::Text("Frame: %.2fM cycles, IPC %.2f, %.1fK cache misses, %.1fK branch misses",
+                hw[HardwareCounters::Cycles] / 1e6, hw.ipc(), hw[HardwareCounters::CacheMisses] / 1e3, hw[HardwareCounters::BranchMisses] / 1e3);
+
+            if (ImGui::BeginTable("CounterZones", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+                for (const char* column : { "Zone", "Calls", "Cycles/call", "IPC", "Cache misses/call", "Branch misses/call" }) {
+                    ImGui::TableSetupColumn(column);
+                }
+                ImGui::TableHeadersRow();
+                hardwareCounters.zones(counterZones);
+                for (const auto& zone : counterZones) {
+                    double calls = static_cast<double>(zone.calls);
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(zone.name);
+                    ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(zone.calls));
+                    ImGui::TableNextColumn(); ImGui::Text("%.0f", zone.totals[HardwareCounters::Cycles] / calls);
+                    ImGui::TableNextColumn(); ImGui::Text("%.2f", zone.totals.ipc());
+                    ImGui::TableNextColumn(); ImGui::Text("%.0f", zone.totals[HardwareCounters::CacheMisses] / calls);
+                    ImGui::TableNextColumn(); ImGui::Text("%.0f", zone.totals[HardwareCounters::BranchMisses] / calls);
+                }
+                ImGui::EndTable();
+            }
+            if (ImGui::Button("Reset Zones")) hardwareCounters.resetZones();
+        }
+
+        const auto& events = cpuProfiler.lastFrame();
+        cpuProfiler.threadNames(cpuThreadNames);
+        float frameMs = cpuProfiler.lastFrameTime();
+        for (size_t i = 0; i < events.size();) {
+            int thread = events[i].thread;
+            if (ImGui::TreeNodeEx(cpuThreadNames[thread].c_str(), ImGuiTreeNodeFlags_DefaultOpen)) {
+                while (i < events.size() && events[i].thread == thread) i = drawCpuZones(events, i, frameMs);
+                ImGui::TreePop();
+            }
+            else {
+                while (i < events.size() && events[i].thread == thread) i++;
+            }
+        }
+        ImGui::TreePop();
+    }
+
     ImGui::Spacing();
 
     // maybe make this recursive?
@@ -148,7 +433,7 @@ void Gui::draw() {
             std::string filePathName = ImGuiFileDialog::Instance()->GetFilePathName();
 
             if (app->scene->skybox) {
-                app->scene->skybox->load(filePathName);
+                app->renderThread.run([&] { app->scene->skybox->load(filePathName); });
                 logger.info("Loaded new skybox: " + filePathName);
             }
         }
@@ -184,7 +469,24 @@ void Gui::draw() {
                     // meshes
                     if (!obj->meshes.empty() && ImGui::TreeNode("Meshes")) {
                         for (int i = 0; i < (int)obj->meshes.size(); i++) {
-                            ImGui::BulletText("Mesh %d", i);
+                            Mesh& mesh = *obj->meshes[i];
+                            ImGui::BulletText("Mesh %d: %zu vertices, %zu indices%s", i, mesh.vertexCount, mesh.indexCount, mesh.cpuResident() ? "" : " (GPU only)");
+                            ImGui::SameLine();
+                            ImGui::PushID(i);
+                            if (ImGui::SmallButton("Export OBJ")) {
+                                // static meshes only live on the GPU, copy them back where the context is
+                                bool wasResident = mesh.cpuResident();
+                                bool resident = wasResident;
+                                if (!wasResident) app->renderThread.run([&] { resident = mesh.readback(); });
+
+                                std::string path = obj->name + "_" + std::to_string(i) + ".obj";
+                                for (char& c : path) if (!std::isalnum(static_cast<unsigned char>(c)) && c != '.') c = '_';
+                                if (resident && exportObj(mesh, path)) logger.info("Exported mesh: " + path);
+                                else logger.error("Failed to export mesh: " + path);
+
+                                if (!wasResident && resident) mesh.releaseCpuData();
+                            }
+                            ImGui::PopID();
                         }
                         ImGui::TreePop();
                     }
@@ -204,4 +506,24 @@ void Gui::draw() {
     }
 
     ImGui::End();
+}
+
+size_t Gui::drawCpuZones(const std::vector<CpuProfiler::FrameEvent>& events, size_t index, float frameMs) {
+    const auto& zone = events[index];
+
+    // children follow their parent in start order, deeper and on the same thread
+    size_t end = index + 1;
+    while (end < events.size() && events[end].thread == zone.thread && events[end].event.depth > zone.event.depth) end++;
+
+    float ms = (zone.event.end - zone.event.start) / 1000000.0f;
+    float share = frameMs > 0.0f ? 100.0f * ms / frameMs : 0.0f;
+    bool leaf = end == index + 1;
+    ImGuiTreeNodeFlags flags = leaf ? ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen : 0;
+
+    bool open = ImGui::TreeNodeEx(reinterpret_cast<void*>(static_cast<intptr_t>(index)), flags, "%s  %.3f ms (%.0f%%)", zone.event.name, ms, share);
+    if (open && !leaf) {
+        for (size_t i = index + 1; i < end;) i = drawCpuZones(events, i, frameMs);
+        ImGui::TreePop();
+    }
+    return end;
 }
\ No newline at end of file
@@ -8,6 +8,13 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <vector>
+#include <string>
+
+#include "CommandBuffer.h"
+#include "ResourceRegistry.h"
+#include "CpuProfiler.h"
+#include "HardwareCounters.h"
+#include "AllocationTracker.h"
 
 class App; // forward declaration
 
@@ -20,14 +27,29 @@ public:
     void shutdown();
 
     void beginFrame();
-    void endFrame();
+    // finish the gui frame and record its draw into cmd, the draw data is copied so it survives the next frame
+    void endFrame(CommandBuffer& cmd);
 
     void draw();
 
+    // ms, 0 until the history has been filled once
+    float averageFrameTime() const { return framesSampled < FRAME_HIST_COUNT ? 0.0f : movingAverage; }
+
 private:
     App* app = nullptr; // to interact with application processes
     bool active = false; // flag
 
+    // copies of ImGui's draw data, one being replayed while the other is written
+    struct DrawSnapshot {
+        ImDrawData data;
+        ImVector<ImDrawList*> lists; // reused between frames, only ever grown
+    };
+    DrawSnapshot drawSnapshots[2];
+    int drawSnapshotIndex = 0;
+
+    static void copyDrawData(const ImDrawData& src, DrawSnapshot& dst);
+    static void renderDrawSnapshot(void* snapshot); // runs on the GL thread
+
     // profiler stuff
     static const int FRAME_HIST_COUNT = 100;
     float frameTimeHistory[FRAME_HIST_COUNT] = { 0 };
@@ -36,4 +58,14 @@ private:
 
     float frameTimeSum = 0.0f;     // running sum; moving average
     float movingAverage = 0.0f;
+    int framesSampled = 0;
+
+    std::vector<ResourceRegistry::Entry> topResources; // memory panel, reused every frame
+
+    // CPU zones of the last frame as a tree, returns the index after the zone and its children
+    static size_t drawCpuZones(const std::vector<CpuProfiler::FrameEvent>& events, size_t index, float frameMs);
+    std::vector<std::string> cpuThreadNames;
+    std::vector<HardwareCounters::ZoneStats> counterZones;
+    std::vector<AllocationTracker::ThreadCounts> allocationThreads;
+    std::vector<AllocationTracker::Site> allocationSites;
 };
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "HardwareCounters.h"
+
+#include <logger.h>
+#include <algorithm>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+const char* HardwareCounters::name(int counter) {
+	switch (counter) {
+	case Cycles: return "Cycles";
+	case Instructions: return "Instructions";
+	case CacheMisses: return "Cache misses";
+	case BranchMisses: return "Branch misses";
+	default: return "Unknown";
+	}
+}
+
+HardwareCounters::Values HardwareCounters::Values::operator-(const Values& other) const {
+	Values v;
+	for (int i = 0; i < COUNT; i++) v.values[i] = values[i] >= other.values[i] ? values[i] - other.values[i] : 0;
+	return v;
+}
+
+HardwareCounters::Values& HardwareCounters::Values::operator+=(const Values& other) {
+	for (int i = 0; i < COUNT; i++) values[i] += other.values[i];
+	return *this;
+}
+
+HardwareCounters::~HardwareCounters() {
+	for (auto& group : groups) group->close();
+}
+
+#ifdef __linux__
+
+static int currentThreadId() {
+	return static_cast<int>(syscall(SYS_gettid));
+}
+
+bool HardwareCounters::Group::open() {
+	if (fds[0] >= 0) return true;
+
+	static const uint64_t configs[COUNT] = {
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	for (int i = 0; i < COUNT; i++) {
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[i];
+		attr.disabled = i == 0; // the group starts when the leader is enabled
+		attr.exclude_kernel = 1; // all that perf_event_paranoid 2 allows
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, tid, -1, i == 0 ? -1 : fds[0], 0));
+		if (fd < 0) {
+			if (i == 0) return false;
+			continue; // some PMUs (VMs) lack a counter, keep the others
+		}
+		fds[i] = fd;
+		ioctl(fd, PERF_EVENT_IOC_ID, &ids[i]);
+	}
+
+	ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	return true;
+}
+
+void HardwareCounters::Group::close() {
+	for (int& fd : fds) {
+		if (fd >= 0) ::close(fd);
+		fd = -1;
+	}
+}
+
+bool HardwareCounters::Group::read(Values& out) const {
+	if (fds[0] < 0) return false;
+
+	struct {
+		uint64_t nr;
+		uint64_t timeEnabled;
+		uint64_t timeRunning;
+		struct { uint64_t value; uint64_t id; } values[COUNT];
+	} data;
+	if (::read(fds[0], &data, sizeof(data)) <= 0) return false;
+
+	// more events than hardware counters get multiplexed, scale up to the full time
+	double scale = data.timeRunning ? static_cast<double>(data.timeEnabled) / data.timeRunning : 1.0;
+	for (uint64_t n = 0; n < data.nr && n < COUNT; n++) {
+		for (int i = 0; i < COUNT; i++) {
+			if (fds[i] >= 0 && ids[i] == data.values[n].id) out.values[i] = static_cast<uint64_t>(data.values[n].value * scale);
+		}
+	}
+	return true;
+}
+
+#else
+
+static int currentThreadId() { return 0; }
+bool HardwareCounters::Group::open() { return false; }
+void HardwareCounters::Group::close() {}
+bool HardwareCounters::Group::read(Values&) const { return false; }
+
+#endif
+
+void HardwareCounters::registerThread() {
+	threadGroup();
+}
+
+HardwareCounters::Group* HardwareCounters::threadGroup() {
+	thread_local Group* group = nullptr;
+	HardwareCounters& counters = instance();
+	std::lock_guard<std::mutex> lock(counters.mtx);
+
+	if (!group) {
+		counters.groups.push_back(std::make_unique<Group>());
+		group = counters.groups.back().get();
+		group->tid = currentThreadId();
+	}
+	if (enabled() && !group->open()) return nullptr;
+	return group;
+}
+
+bool HardwareCounters::enable() {
+	if (failed) return false;
+
+	std::lock_guard<std::mutex> lock(mtx);
+#ifdef __linux__
+	for (auto& group : groups) {
+		if (group->open()) {
+			group->read(group->frameStart);
+			continue;
+		}
+
+		int error = errno;
+		if (error == ESRCH) continue; // the thread is gone
+
+		statusText = std::string("perf_event_open failed: ") + std::strerror(error);
+		if (error == EACCES || error == EPERM) statusText += " (see /proc/sys/kernel/perf_event_paranoid)";
+		logger.warning("hardware counters unavailable, " + statusText);
+		for (auto& g : groups) g->close();
+		failed = true;
+		return false;
+	}
+	statusText = "counting " + std::to_string(groups.size()) + " threads";
+	s_Enabled.store(true, std::memory_order_relaxed);
+	return true;
+#else
+	statusText = "perf_event_open needs Linux";
+	logger.warning("hardware counters unavailable, " + statusText);
+	failed = true;
+	return false;
+#endif
+}
+
+void HardwareCounters::disable() {
+	// the groups stay open, a zone on another thread may still be reading its own
+	s_Enabled.store(false, std::memory_order_relaxed);
+	if (!failed) statusText = "off";
+}
+
+void HardwareCounters::endFrame() {
+	if (!enabled()) return;
+
+	std::lock_guard<std::mutex> lock(mtx);
+	Values total;
+	for (auto& group : groups) {
+		Values now = group->frameStart;
+		if (!group->read(now)) continue;
+		total += now - group->frameStart;
+		group->frameStart = now;
+	}
+	frameValues = total;
+}
+
+void HardwareCounters::addZone(const char* name, const Values& delta) {
+	std::lock_guard<std::mutex> lock(mtx);
+	auto it = std::find_if(zoneStats.begin(), zoneStats.end(), [&](const ZoneStats& z) { return std::strcmp(z.name, name) == 0; });
+	if (it == zoneStats.end()) {
+		zoneStats.push_back({ name, 0, Values() });
+		it = zoneStats.end() - 1;
+	}
+	it->calls++;
+	it->totals += delta;
+}
+
+void HardwareCounters::zones(std::vector<ZoneStats>& out) const {
+	std::lock_guard<std::mutex> lock(mtx);
+	out = zoneStats;
+}
+
+void HardwareCounters::resetZones() {
+	std::lock_guard<std::mutex> lock(mtx);
+	zoneStats.clear();
+}
+
+HardwareCounters::Zone::Zone(const char* name) {
+	if (!enabled()) return;
+	Group* group = threadGroup();
+	if (group && group->read(start)) zoneName = name;
+}
+
+HardwareCounters::Zone::~Zone() {
+	if (!zoneName) return;
+	Values end = start;
+	Group* group = threadGroup();
+	if (group && group->read(end)) instance().addZone(zoneName, end - start);
+}
\ No newline at end of file
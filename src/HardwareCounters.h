@@ -0,0 +1,115 @@
+// CPU hardware counters (cycles, instructions, cache and branch misses) through Linux perf_event_open
+// Counted per frame over every registered thread, and per zone for the zones placed with PROFILE_ZONE_COUNTERS
+// Off by default; when counters are not permitted (perf_event_paranoid, containers) or not on Linux,
+// enable() fails, logs why once and everything reads as 0
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "CpuProfiler.h"
+
+class HardwareCounters {
+public:
+	enum Counter { Cycles, Instructions, CacheMisses, BranchMisses, COUNT };
+	static const char* name(int counter);
+
+	struct Values {
+		uint64_t values[COUNT] = {};
+		uint64_t operator[](int counter) const { return values[counter]; }
+		Values operator-(const Values& other) const;
+		Values& operator+=(const Values& other);
+		float ipc() const { return values[Cycles] ? static_cast<float>(values[Instructions]) / values[Cycles] : 0.0f; }
+	};
+
+	struct ZoneStats {
+		const char* name;
+		uint64_t calls;
+		Values totals;
+	};
+
+	static HardwareCounters& instance() {
+		static HardwareCounters counters;
+		return counters;
+	}
+
+	// opens counters for every registered thread, false (with the reason in status()) if that isn't allowed
+	bool enable();
+	void disable();
+	static bool enabled() { return s_Enabled.load(std::memory_order_relaxed); }
+	const std::string& status() const { return statusText; }
+
+	// counts the calling thread in the per frame totals, cheap, may be called before enable()
+	// threads that only run counter zones are picked up on their first zone
+	static void registerThread();
+
+	// once per frame on the main thread: the counts of all threads since the last call
+	void endFrame();
+	const Values& lastFrame() const { return frameValues; }
+
+	// per zone totals since the last reset, by name
+	void zones(std::vector<ZoneStats>& out) const; // reuses out's storage
+	void resetZones();
+
+	// RAII, use PROFILE_ZONE_COUNTERS
+	class Zone {
+	public:
+		explicit Zone(const char* name);
+		~Zone();
+
+	private:
+		const char* zoneName = nullptr;
+		Values start;
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+	};
+
+private:
+	// one perf event group per thread, led by the cycle counter
+	struct Group {
+		int tid = 0;
+		int fds[COUNT] = { -1, -1, -1, -1 };
+		uint64_t ids[COUNT] = {};
+		Values frameStart;
+
+		bool open();
+		void close();
+		bool read(Values& out) const;
+	};
+
+	HardwareCounters() = default;
+	~HardwareCounters();
+
+	// prevent copying
+	HardwareCounters(const HardwareCounters&) = delete;
+	HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+	static inline std::atomic<bool> s_Enabled{ false };
+
+	static Group* threadGroup(); // the calling thread's group, opened on first use while enabled
+	void addZone(const char* name, const Values& delta);
+
+	mutable std::mutex mtx;
+	std::vector<std::unique_ptr<Group>> groups;
+	std::vector<int> threads; // registered thread ids
+	std::vector<ZoneStats> zoneStats;
+	Values frameValues;
+	std::string statusText = "off";
+	bool failed = false;
+};
+
+// declare global
+inline HardwareCounters& hardwareCounters = HardwareCounters::instance();
+
+// a profiler zone that also counts hardware events, costs two syscalls while counters are enabled
+// meant for a few hot paths, not for every zone
+#if KESTREL_PROFILER
+#define PROFILE_ZONE_COUNTERS(name) PROFILE_ZONE(name); HardwareCounters::Zone PROFILE_CONCAT(counterZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE_COUNTERS(name) ((void)0)
+#endif
\ No newline at end of file
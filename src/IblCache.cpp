@@ -0,0 +1,245 @@
+#include "IblCache.h"
+#include "CpuProfiler.h"
+
+#include <logger.h>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+namespace {
+
+	constexpr uint32_t FORMAT_VERSION = 1;
+
+	enum class EntryType : uint32_t { Environment, BrdfLUT };
+
+	struct Header {
+		char magic[4] = { 'K', 'I', 'B', 'L' };
+		uint32_t version = FORMAT_VERSION;
+		uint64_t key = 0;
+		EntryType type = EntryType::Environment;
+		int32_t size = 0;			// environment or LUT
+		int32_t prefilterSize = 0;
+		int32_t prefilterMips = 0;
+	};
+
+	// four independent lanes of 8 byte words, so hashing a large HDR runs at memory speed
+	class Hasher {
+	public:
+		void update(const void* data, size_t size) {
+			const unsigned char* p = static_cast<const unsigned char*>(data);
+			total += size;
+
+			if (tailSize > 0) {
+				size_t take = std::min(size, sizeof(tail) - tailSize);
+				std::memcpy(tail + tailSize, p, take);
+				tailSize += take;
+				p += take;
+				size -= take;
+				if (tailSize < sizeof(tail)) return;
+				block(tail);
+				tailSize = 0;
+			}
+			for (; size >= sizeof(tail); p += sizeof(tail), size -= sizeof(tail)) block(p);
+
+			std::memcpy(tail, p, size);
+			tailSize = size;
+		}
+
+		uint64_t finish() const {
+			uint64_t hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+			hash ^= total;
+			for (size_t i = 0; i < tailSize; i++) hash = rotl(hash ^ (tail[i] * P5), 11) * P1;
+
+			// avalanche, and 0 stays free to mean "no key"
+			hash ^= hash >> 33;
+			hash *= P2;
+			hash ^= hash >> 29;
+			hash *= P3;
+			hash ^= hash >> 32;
+			return hash ? hash : 1;
+		}
+
+	private:
+		static constexpr uint64_t P1 = 0x9E3779B185EBCA87ull;
+		static constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+		static constexpr uint64_t P3 = 0x165667B19E3779F9ull;
+		static constexpr uint64_t P5 = 0x27D4EB2F165667C5ull;
+
+		uint64_t lanes[4] = { P1 + P2, P2, 0, 0 - P1 };
+		unsigned char tail[32] = {};
+		size_t tailSize = 0;
+		uint64_t total = 0;
+
+		static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+		void block(const unsigned char* p) {
+			for (int i = 0; i < 4; i++) {
+				uint64_t word;
+				std::memcpy(&word, p + i * 8, sizeof(word));
+				lanes[i] = rotl(lanes[i] + word * P2, 31) * P1;
+			}
+		}
+	};
+
+	bool readExact(std::ifstream& file, void* data, size_t size) {
+		file.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+		return static_cast<size_t>(file.gcount()) == size;
+	}
+
+	bool readHeader(std::ifstream& file, uint64_t key, EntryType type, Header& header) {
+		const Header expected;
+		return readExact(file, &header, sizeof(header)) && std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+			&& header.version == FORMAT_VERSION && header.key == key && header.type == type && header.size > 0;
+	}
+
+	// written next to the entry and renamed over it, so a crash mid write never leaves a truncated entry
+	template<typename WriteFn>
+	bool writeEntry(const std::string& path, const WriteFn& write) {
+		std::error_code error;
+		std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+		std::string temp = path + ".tmp";
+		{
+			std::ofstream file(temp, std::ios::binary);
+			if (!file || !write(file) || !file.flush()) {
+				logger.error("failed to write IBL cache entry: " + path);
+				file.close();
+				std::filesystem::remove(temp, error);
+				return false;
+			}
+		}
+		std::filesystem::rename(temp, path, error);
+		if (error) {
+			logger.error("failed to write IBL cache entry: " + path + " (" + error.message() + ")");
+			std::filesystem::remove(temp, error);
+			return false;
+		}
+		return true;
+	}
+
+}
+
+size_t IblBake::prefilterTexels(int size, int mips) {
+	size_t texels = 0;
+	for (int mip = 0; mip < mips; mip++) texels += environmentTexels(std::max(1, size >> mip));
+	return texels;
+}
+
+uint64_t IblCache::key(std::initializer_list<std::string> files, const void* params, size_t paramsSize) {
+	PROFILE_ZONE("IblCache::key");
+
+	Hasher hasher;
+	hasher.update(&FORMAT_VERSION, sizeof(FORMAT_VERSION));
+	hasher.update(params, paramsSize);
+
+	std::vector<char> chunk(1 << 20);
+	for (const std::string& path : files) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) return 0;
+
+		uint64_t size = 0;
+		while (file) {
+			file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+			size_t read = static_cast<size_t>(file.gcount());
+			hasher.update(chunk.data(), read);
+			size += read;
+		}
+		// keeps the boundary between two files from moving without changing the key
+		hasher.update(&size, sizeof(size));
+	}
+	return hasher.finish();
+}
+
+std::string IblCache::path(uint64_t key) const {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.ibl", static_cast<unsigned long long>(key));
+	return directory + "/" + name;
+}
+
+bool IblCache::load(uint64_t key, int environmentSize, int prefilterSize, int prefilterMips, IblBake& bake) const {
+	PROFILE_ZONE("IblCache::load");
+
+	std::ifstream file(path(key), std::ios::binary);
+	if (!file) return false;
+
+	Header header;
+	if (!readHeader(file, key, EntryType::Environment, header) || header.size != environmentSize
+		|| header.prefilterSize != prefilterSize || header.prefilterMips != prefilterMips) {
+		logger.warning("ignoring IBL cache entry that doesn't match: " + path(key));
+		return false;
+	}
+
+	bake.environmentSize = environmentSize;
+	bake.prefilterSize = prefilterSize;
+	bake.prefilterMips = prefilterMips;
+	bake.environment.resize(IblBake::environmentTexels(bake.environmentSize) * 3);
+	bake.prefilter.resize(IblBake::prefilterTexels(bake.prefilterSize, bake.prefilterMips) * 4);
+
+	if (!readExact(file, bake.shCoefficients, sizeof(bake.shCoefficients))
+		|| !readExact(file, bake.environment.data(), bake.environment.size() * sizeof(uint16_t))
+		|| !readExact(file, bake.prefilter.data(), bake.prefilter.size() * sizeof(uint16_t))) {
+		logger.warning("ignoring truncated IBL cache entry: " + path(key));
+		return false;
+	}
+	return true;
+}
+
+bool IblCache::save(uint64_t key, const IblBake& bake) const {
+	PROFILE_ZONE("IblCache::save");
+
+	if (bake.environment.size() != IblBake::environmentTexels(bake.environmentSize) * 3
+		|| bake.prefilter.size() != IblBake::prefilterTexels(bake.prefilterSize, bake.prefilterMips) * 4) {
+		logger.error("not caching an IBL bake with unexpected sizes");
+		return false;
+	}
+
+	Header header;
+	header.key = key;
+	header.type = EntryType::Environment;
+	header.size = bake.environmentSize;
+	header.prefilterSize = bake.prefilterSize;
+	header.prefilterMips = bake.prefilterMips;
+
+	return writeEntry(path(key), [&](std::ofstream& file) {
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(bake.shCoefficients), sizeof(bake.shCoefficients));
+		file.write(reinterpret_cast<const char*>(bake.environment.data()), static_cast<std::streamsize>(bake.environment.size() * sizeof(uint16_t)));
+		file.write(reinterpret_cast<const char*>(bake.prefilter.data()), static_cast<std::streamsize>(bake.prefilter.size() * sizeof(uint16_t)));
+		return static_cast<bool>(file);
+	});
+}
+
+bool IblCache::loadLUT(uint64_t key, int size, std::vector<uint16_t>& texels) const {
+	std::ifstream file(path(key), std::ios::binary);
+	if (!file) return false;
+
+	Header header;
+	if (!readHeader(file, key, EntryType::BrdfLUT, header) || header.size != size) {
+		logger.warning("ignoring IBL cache entry that doesn't match: " + path(key));
+		return false;
+	}
+
+	texels.resize(static_cast<size_t>(size) * size * 2);
+	if (!readExact(file, texels.data(), texels.size() * sizeof(uint16_t))) {
+		logger.warning("ignoring truncated IBL cache entry: " + path(key));
+		return false;
+	}
+	return true;
+}
+
+bool IblCache::saveLUT(uint64_t key, int size, const std::vector<uint16_t>& texels) const {
+	if (texels.size() != static_cast<size_t>(size) * size * 2) return false;
+
+	Header header;
+	header.key = key;
+	header.type = EntryType::BrdfLUT;
+	header.size = size;
+
+	return writeEntry(path(key), [&](std::ofstream& file) {
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(texels.data()), static_cast<std::streamsize>(texels.size() * sizeof(uint16_t)));
+		return static_cast<bool>(file);
+	});
+}
\ No newline at end of file
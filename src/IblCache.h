@@ -0,0 +1,43 @@
+// On-disk cache for the baked image based lighting, so an environment that was seen before skips decoding and baking
+// Entries are keyed by a hash of everything that goes into a bake: the source file's contents,
+// the bake sizes and the shaders that do the baking, so editing any of them bakes again
+#pragma once
+
+#include <glm/glm.hpp>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// everything Skybox bakes from one HDRI, texels as half floats in the layout glGetTextureImage returns
+struct IblBake {
+	int environmentSize = 0;				// face size of the environment cubemap
+	std::vector<uint16_t> environment;		// RGB, 6 faces
+	int prefilterSize = 0;					// face size of mip 0
+	int prefilterMips = 0;
+	std::vector<uint16_t> prefilter;		// RGBA, 6 faces per mip, mip 0 first
+	glm::vec4 shCoefficients[9] = {};		// irradiance, rgb
+
+	static size_t environmentTexels(int size) { return static_cast<size_t>(size) * size * 6; }
+	static size_t prefilterTexels(int size, int mips);
+};
+
+class IblCache {
+public:
+	std::string directory = "cache/ibl";	// entries go to <directory>/<key>.ibl
+
+	// 0 when a file can't be read, params are hashed as raw bytes so they must not have padding
+	static uint64_t key(std::initializer_list<std::string> files, const void* params, size_t paramsSize);
+
+	// false on a miss or an entry that doesn't match what it should contain, sizes included
+	bool load(uint64_t key, int environmentSize, int prefilterSize, int prefilterMips, IblBake& bake) const;
+	bool save(uint64_t key, const IblBake& bake) const;
+
+	// the BRDF lookup table doesn't depend on the environment, so it gets its own entry
+	bool loadLUT(uint64_t key, int size, std::vector<uint16_t>& texels) const; // RG
+	bool saveLUT(uint64_t key, int size, const std::vector<uint16_t>& texels) const;
+
+private:
+	std::string path(uint64_t key) const;
+};
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "LightClusters.h"
+#include "lights/PointLight.h"
+#include "lights/SpotLight.h"
+
+#include <algorithm>
+#include <cmath>
+
+int LightClusters::sliceFromDepth(float viewDepth, float nearPlane, float farPlane) {
+	// exponential slices, the same mapping is done per fragment in model.frag
+	float slice = std::log(viewDepth / nearPlane) / std::log(farPlane / nearPlane) * GRID_Z;
+	return std::clamp(static_cast<int>(slice), 0, GRID_Z - 1);
+}
+
+void LightClusters::build(const Scene& scene, Frame& frame, LinearArena& scratch) {
+	auto& lights = frame.lights;
+	auto& clusters = frame.clusters;
+	auto& indices = frame.indices;
+
+	lights.clear();
+	ArenaVector<glm::vec3> viewCenters(ArenaAllocator<glm::vec3>{ scratch }); // view space light centers, parallel to lights
+	ArenaVector<ClusterRange> ranges(ArenaAllocator<ClusterRange>{ scratch });
+	viewCenters.reserve(scene.lights.size());
+	ranges.reserve(scene.lights.size());
+
+	const float nearPlane = frame.nearPlane = scene.camera.nearPlane;
+	const float farPlane = frame.farPlane = scene.camera.farPlane;
+	frame.screenSize = scene.camera.getViewportSize();
+
+	glm::mat4 view = scene.camera.getViewMatrix();
+	glm::mat4 projection = scene.camera.getProjectionMatrix();
+
+	// gather point and spot lights, directional lights are handled separately
+	for (const auto& light : scene.lights) {
+		GpuLight gpu;
+		if (auto point = std::dynamic_pointer_cast<PointLight>(light)) {
+			gpu.positionRange = glm::vec4(point->transform.position, point->range);
+			gpu.colorIntensity = glm::vec4(point->color, point->intensity);
+			gpu.direction = glm::vec4(0.0f);
+			gpu.spotCone = glm::vec4(0.0f);
+		}
+		else if (auto spot = std::dynamic_pointer_cast<SpotLight>(light)) {
+			gpu.positionRange = glm::vec4(spot->transform.position, spot->range);
+			gpu.colorIntensity = glm::vec4(spot->color, spot->intensity);
+			gpu.direction = glm::vec4(glm::normalize(spot->direction), 1.0f);
+			gpu.spotCone = glm::vec4(
+				std::cos(glm::radians(spot->innerAngle)),
+				std::cos(glm::radians(spot->outerAngle)),
+				0.0f, 0.0f);
+		}
+		else {
+			continue;
+		}
+
+		lights.push_back(gpu);
+		viewCenters.push_back(glm::vec3(view * glm::vec4(glm::vec3(gpu.positionRange), 1.0f)));
+	}
+
+	// find the block of clusters each light's bounding sphere can touch
+	// binning per light keeps the cost proportional to the clusters actually covered
+	clusters.assign(CLUSTER_COUNT, glm::uvec2(0));
+
+	for (size_t i = 0; i < lights.size(); i++) {
+		const glm::vec3& c = viewCenters[i];
+		float r = lights[i].positionRange.w;
+
+		// view space depth range, the camera looks down -z
+		float depthMin = -c.z - r;
+		float depthMax = -c.z + r;
+		if (depthMax < nearPlane || depthMin > farPlane) {
+			ranges.push_back({ 0, -1, 0, -1, 0, -1 }); // off screen, empty range
+			continue;
+		}
+
+		ClusterRange range = { 0, GRID_X - 1, 0, GRID_Y - 1, 0, GRID_Z - 1 };
+		range.z0 = sliceFromDepth(std::max(depthMin, nearPlane), nearPlane, farPlane);
+		range.z1 = sliceFromDepth(std::min(depthMax, farPlane), nearPlane, farPlane);
+
+		// screen rect from the projected corners of the sphere's bounding box
+		// spheres crossing the near plane are treated as covering the whole screen
+		if (depthMin > nearPlane) {
+			glm::vec2 ndcMin(1.0f), ndcMax(-1.0f);
+			for (int corner = 0; corner < 8; corner++) {
+				glm::vec3 p(
+					c.x + ((corner & 1) ? r : -r),
+					c.y + ((corner & 2) ? r : -r),
+					c.z + ((corner & 4) ? r : -r));
+				glm::vec4 clip = projection * glm::vec4(p, 1.0f);
+				glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+				ndcMin = glm::min(ndcMin, ndc);
+				ndcMax = glm::max(ndcMax, ndc);
+			}
+
+			if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f) {
+				ranges.push_back({ 0, -1, 0, -1, 0, -1 });
+				continue;
+			}
+
+			range.x0 = std::clamp(static_cast<int>((ndcMin.x * 0.5f + 0.5f) * GRID_X), 0, GRID_X - 1);
+			range.x1 = std::clamp(static_cast<int>((ndcMax.x * 0.5f + 0.5f) * GRID_X), 0, GRID_X - 1);
+			range.y0 = std::clamp(static_cast<int>((ndcMin.y * 0.5f + 0.5f) * GRID_Y), 0, GRID_Y - 1);
+			range.y1 = std::clamp(static_cast<int>((ndcMax.y * 0.5f + 0.5f) * GRID_Y), 0, GRID_Y - 1);
+		}
+
+		ranges.push_back(range);
+
+		// count pass
+		for (int z = range.z0; z <= range.z1; z++)
+			for (int y = range.y0; y <= range.y1; y++)
+				for (int x = range.x0; x <= range.x1; x++)
+					clusters[x + GRID_X * (y + GRID_Y * z)].y++;
+	}
+
+	// prefix sum into offsets, capping overfull clusters
+	unsigned int offset = 0;
+	for (auto& cluster : clusters) {
+		unsigned int count = std::min(cluster.y, (unsigned int)MAX_LIGHTS_PER_CLUSTER);
+		cluster = glm::uvec2(offset, 0); // count is rebuilt by the fill pass
+		offset += count;
+	}
+	indices.resize(offset);
+
+	// fill pass
+	for (size_t i = 0; i < ranges.size(); i++) {
+		const ClusterRange& range = ranges[i];
+		for (int z = range.z0; z <= range.z1; z++)
+			for (int y = range.y0; y <= range.y1; y++)
+				for (int x = range.x0; x <= range.x1; x++) {
+					auto& cluster = clusters[x + GRID_X * (y + GRID_Y * z)];
+					if (cluster.y < MAX_LIGHTS_PER_CLUSTER) {
+						indices[cluster.x + cluster.y++] = static_cast<unsigned int>(i);
+					}
+				}
+	}
+}
+
+// empty ranges can't be bound, shaders never index past the counts anyway
+static void bindStorage(CommandBuffer& cmd, StreamBuffer& ring, unsigned int binding, const void* data, size_t size) {
+	static const unsigned int zero[4] = {};
+	auto a = size ? ring.write(data, size, ring.storageAlignment) : ring.write(zero, sizeof(zero), ring.storageAlignment);
+	if (a.ptr) cmd.bindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, ring.id(), a.offset, a.size);
+}
+
+void LightClusters::upload(CommandBuffer& cmd, StreamBuffer& ring, const Frame& frame) {
+	bindStorage(cmd, ring, LIGHTS_BINDING, frame.lights.data(), frame.lights.size() * sizeof(GpuLight));
+	bindStorage(cmd, ring, CLUSTERS_BINDING, frame.clusters.data(), frame.clusters.size() * sizeof(glm::uvec2));
+	bindStorage(cmd, ring, INDICES_BINDING, frame.indices.data(), frame.indices.size() * sizeof(unsigned int));
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+// Clustered light culling
+// Point and spot lights are binned into a view space froxel grid on the CPU,
+// the grid is streamed as SSBOs so each fragment only loops over the lights of its cluster
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Scene.h"
+#include "StreamBuffer.h"
+#include "FrameArena.h"
+
+class LightClusters {
+public:
+	// keep in sync with model.frag
+	static constexpr int GRID_X = 16;
+	static constexpr int GRID_Y = 9;
+	static constexpr int GRID_Z = 24;
+	static constexpr int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+	static constexpr int MAX_LIGHTS_PER_CLUSTER = 256;
+
+	// SSBO binding points
+	static constexpr int LIGHTS_BINDING = 1;
+	static constexpr int CLUSTERS_BINDING = 2;
+	static constexpr int INDICES_BINDING = 3;
+
+	// std430 layout, see model.frag
+	struct GpuLight {
+		glm::vec4 positionRange;	// xyz position, w range
+		glm::vec4 colorIntensity;	// rgb color, a intensity
+		glm::vec4 direction;		// xyz spot direction, w 1 for spot lights
+		glm::vec4 spotCone;			// x cos inner, y cos outer
+	};
+
+	// output of one build, kept separate so a frame can be binned while another is uploaded
+	struct Frame {
+		std::vector<GpuLight> lights;
+		std::vector<glm::uvec2> clusters;	// offset, count into indices
+		std::vector<unsigned int> indices;
+
+		float nearPlane = 0.1f;
+		float farPlane = 400.0f;
+		glm::vec2 screenSize = glm::vec2(1.0f);
+
+		int lightCount() const { return static_cast<int>(lights.size()); }
+		int indexCount() const { return static_cast<int>(indices.size()); }
+	};
+
+	// CPU side binning, no GL calls, the binning scratch comes from the arena
+	void build(const Scene& scene, Frame& frame, LinearArena& scratch);
+
+	// copy a build into the ring buffer and record the SSBO bindings
+	void upload(CommandBuffer& cmd, StreamBuffer& ring, const Frame& frame);
+
+private:
+	// per light cluster ranges, shared by the count and fill passes
+	struct ClusterRange { int x0, x1, y0, y1, z0, z1; };
+
+	static int sliceFromDepth(float viewDepth, float nearPlane, float farPlane);
+};
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "ModelLoader.h"
+#include "HardwareCounters.h"
 #include "stb_image.h"
 
 namespace ModelLoader {
@@ -33,6 +34,8 @@ namespace ModelLoader {
 		std::vector<std::shared_ptr<Texture>>& textureCache, 
 		glm::vec3 scale
 	) {
+		PROFILE_ZONE("ModelLoader::loadAsObjects");
+
 		Assimp::Importer importer;
 		const aiScene* assimpScene = importer.ReadFile(path,
 			aiProcess_Triangulate |
@@ -99,6 +102,8 @@ namespace ModelLoader {
 		Object& object,
 		std::vector<std::shared_ptr<Texture>>& textureCache
 	) {
+		PROFILE_ZONE_COUNTERS("ModelLoader::processMesh");
+
 		std::vector<Mesh::Vertex> vertices;
 		std::vector<unsigned int> indices;
 		std::vector<int> texIndices;
@@ -189,7 +194,7 @@ namespace ModelLoader {
 
 		logger.info("loaded mesh: " + std::string(assimpMesh->mName.C_Str()));
 
-		auto mesh = std::make_shared<Mesh>(vertices, indices);
+		auto mesh = std::make_shared<Mesh>(std::move(vertices), std::move(indices), false, assimpMesh->mName.C_Str());
 		mesh->texIndices = texIndices;
 		return mesh;
 	}
@@ -205,6 +210,7 @@ namespace ModelLoader {
 				return i; // already loaded
 		}
 
+		PROFILE_ZONE("ModelLoader::loadTexture");
 		auto texture = std::make_shared<Texture>(type, path);
 		glGenTextures(1, &texture->id);
 
@@ -224,6 +230,11 @@ namespace ModelLoader {
 			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
 			glGenerateMipmap(GL_TEXTURE_2D);
 
+			// RGB8 is padded to 4 bytes per texel by most drivers
+			size_t texelBytes = nrChannels == 3 ? 4 : static_cast<size_t>(nrChannels);
+			resources.track(ResourceRegistry::Kind::Texture, texture->id, ResourceRegistry::Category::Texture,
+				ResourceRegistry::textureBytes(width, height, texelBytes, 1, true), 0, path);
+
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
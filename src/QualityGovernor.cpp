@@ -0,0 +1,59 @@
+#include "QualityGovernor.h"
+
+#include <logger.h>
+#include <string>
+
+const QualityGovernor::Level QualityGovernor::levels[LEVEL_COUNT] = {
+	// name       scale  shadows  pcf  lod bias
+	{ "Ultra",    1.00f, 4096,    2,   0.0f },
+	{ "High",     1.00f, 2048,    1,   0.0f },
+	{ "Medium",   0.85f, 2048,    1,   0.5f },
+	{ "Low",      0.75f, 1024,    1,   1.0f },
+	{ "Very Low", 0.60f, 1024,    0,   1.0f },
+	{ "Minimum",  0.50f, 512,     0,   2.0f },
+};
+
+bool QualityGovernor::update(float averageFrameTime, float deltaTime) {
+	if (!enabled || averageFrameTime <= 0.0f) {
+		overTime = underTime = 0.0f;
+		return false;
+	}
+
+	if (settle > 0.0f) {
+		settle -= deltaTime;
+		return false;
+	}
+
+	if (averageFrameTime > targetFrameTime * (1.0f + degradeMargin)) {
+		overTime += deltaTime;
+		underTime = 0.0f;
+	}
+	else if (averageFrameTime < targetFrameTime * (1.0f - upgradeMargin)) {
+		underTime += deltaTime;
+		overTime = 0.0f;
+	}
+	else {
+		overTime = underTime = 0.0f;
+	}
+
+	int next = level;
+	if (overTime >= degradeHold && level < LEVEL_COUNT - 1) next = level + 1;
+	else if (underTime >= upgradeHold && level > 0) next = level - 1;
+	if (next == level) return false;
+
+	logger.info("quality " + std::string(levels[level].name) + " -> " + levels[next].name
+		+ " (" + std::to_string(averageFrameTime) + " ms, target " + std::to_string(targetFrameTime) + " ms)");
+
+	level = next;
+	overTime = underTime = 0.0f;
+	settle = settleTime;
+	return true;
+}
+
+void QualityGovernor::apply(Renderer& renderer) const {
+	const Level& l = current();
+	renderer.renderScale = l.renderScale;
+	renderer.shadowResolution = l.shadowResolution;
+	renderer.shadowPcfRadius = l.shadowPcfRadius;
+	renderer.textureLodBias = l.textureLodBias;
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+// Holds a frame time target by trading image quality for speed
+// Steps along a fixed ladder of settings, with separate thresholds and hold times for going down and up,
+// so a frame time hovering around the target doesn't flip the settings back and forth
+#pragma once
+
+#include "Renderer.h"
+
+class QualityGovernor {
+public:
+	struct Level {
+		const char* name;
+		float renderScale;
+		int shadowResolution;
+		int shadowPcfRadius;
+		float textureLodBias;
+	};
+
+	static constexpr int LEVEL_COUNT = 6;
+	static const Level levels[LEVEL_COUNT]; // best first
+
+	bool enabled = false;
+	float targetFrameTime = 1000.0f / 60.0f; // ms
+
+	// degrade above target * (1 + degradeMargin), recover below target * (1 - upgradeMargin)
+	// the gap between the two is the hysteresis band
+	float degradeMargin = 0.10f;
+	float upgradeMargin = 0.25f;
+
+	// seconds the average has to stay outside the band before a step, recovering is more cautious
+	float degradeHold = 0.5f;
+	float upgradeHold = 2.0f;
+
+	// seconds to ignore after a step, the moving average still holds frames from before it
+	float settleTime = 2.0f;
+
+	int level = 1; // defaults of the renderer
+	const Level& current() const { return levels[level]; }
+
+	// feed the frame time moving average (ms) once per frame, returns true when the level changed
+	bool update(float averageFrameTime, float deltaTime);
+
+	// write the current level into the renderer, GPU targets follow in Renderer::updateTargets()
+	void apply(Renderer& renderer) const;
+
+private:
+	float overTime = 0.0f;
+	float underTime = 0.0f;
+	float settle = 0.0f;
+};
\ No newline at end of file
@@ -0,0 +1,78 @@
+// Per frame counters of the GL work the renderer records (draws, triangles, state changes, uploads)
+// Incremented where the work is recorded, published once per frame by Renderer::syncStats()
+//
+// Built with KESTREL_RENDER_STATS=0 every RENDER_STAT_ADD compiles to nothing and the counters stay 0
+#pragma once
+
+#ifndef KESTREL_RENDER_STATS
+#define KESTREL_RENDER_STATS 1
+#endif
+
+#include <atomic>
+#include <cstdint>
+
+class RenderStats {
+public:
+	enum Counter {
+		DrawCalls,
+		Instances,		// draws times their instance count
+		Triangles,
+		ShaderSwitches,
+		TextureBinds,
+		UniformUploads,	// individual uniforms set through a Shader
+		UniformBlocks,	// std140 blocks streamed into the ring
+		COUNT
+	};
+
+	static const char* name(int counter) {
+		static const char* names[COUNT] = {
+			"Draw calls", "Instances", "Triangles", "Shader switches", "Texture binds", "Uniform uploads", "Uniform blocks"
+		};
+		return counter >= 0 && counter < COUNT ? names[counter] : "Unknown";
+	}
+
+	struct Frame {
+		uint64_t values[COUNT] = {};
+		uint64_t operator[](int counter) const { return values[counter]; }
+	};
+
+	static RenderStats& instance() {
+		static RenderStats stats;
+		return stats;
+	}
+
+	// relaxed, counts may come from any thread that records
+	void add(Counter counter, uint64_t n) { current[counter].fetch_add(n, std::memory_order_relaxed); }
+
+	// everything since the last call becomes lastFrame(), call once per frame after recording
+	void endFrame() {
+		for (int i = 0; i < COUNT; i++) last.values[i] = current[i].exchange(0, std::memory_order_relaxed);
+	}
+	const Frame& lastFrame() const { return last; }
+
+private:
+	RenderStats() = default;
+
+	// prevent copying
+	RenderStats(const RenderStats&) = delete;
+	RenderStats& operator=(const RenderStats&) = delete;
+
+	std::atomic<uint64_t> current[COUNT] = {};
+	Frame last;
+};
+
+// declare global
+inline RenderStats& renderStats = RenderStats::instance();
+
+// RENDER_STAT_DRAW counts one draw of indexCount triangle list indices, instanced instances times
+#if KESTREL_RENDER_STATS
+#define RENDER_STAT_ADD(counter, n) renderStats.add(RenderStats::counter, static_cast<uint64_t>(n))
+#define RENDER_STAT_DRAW(indexCount, instances) do { \
+	RENDER_STAT_ADD(DrawCalls, 1); \
+	RENDER_STAT_ADD(Instances, instances); \
+	RENDER_STAT_ADD(Triangles, (indexCount) / 3 * (instances)); \
+} while (0)
+#else
+#define RENDER_STAT_ADD(counter, n) ((void)0)
+#define RENDER_STAT_DRAW(indexCount, instances) ((void)0)
+#endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "RenderThread.h"
+#include "HardwareCounters.h"
+#include "AllocationTracker.h"
+
+RenderThread::~RenderThread() {
+	stop();
+}
+
+void RenderThread::start(GLFWwindow* w) {
+	if (running) return;
+
+	window = w;
+	running = true;
+
+	// a context can only be current on one thread at a time
+	glfwMakeContextCurrent(nullptr);
+	thread = std::thread(&RenderThread::threadLoop, this);
+}
+
+void RenderThread::stop() {
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		if (!running) return;
+		cv.wait(lock, [this] { return !framePending && !task; });
+		running = false;
+	}
+	cv.notify_all();
+	if (thread.joinable()) thread.join();
+
+	glfwMakeContextCurrent(window);
+}
+
+void RenderThread::submit(CommandBuffer& commands) {
+	if (!running) {
+		commands.execute();
+		glfwSwapBuffers(window);
+		commands.reset();
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		cv.wait(lock, [this] { return !framePending; });
+
+		// the replayed buffer keeps its capacity, so recording into it next frame does not allocate
+		std::swap(commands, replaying);
+		framePending = true;
+	}
+	cv.notify_all();
+	commands.reset();
+}
+
+void RenderThread::waitIdle() {
+	if (!running) return;
+
+	std::unique_lock<std::mutex> lock(mtx);
+	cv.wait(lock, [this] { return !framePending && !task; });
+}
+
+void RenderThread::run(const std::function<void()>& fn) {
+	if (!running) {
+		fn();
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mtx);
+	cv.wait(lock, [this] { return !task; });
+	task = &fn;
+	cv.notify_all();
+	cv.wait(lock, [this, &fn] { return task != &fn; });
+}
+
+void RenderThread::threadLoop() {
+	glfwMakeContextCurrent(window);
+	CpuProfiler::setThreadName("Render");
+	HardwareCounters::registerThread();
+	AllocationTracker::setThreadName("Render");
+
+	for (;;) {
+		const std::function<void()>* currentTask = nullptr;
+		bool frame = false;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait(lock, [this] { return task || framePending || !running; });
+
+			// a pending frame was recorded before the task was issued, so it goes first
+			if (framePending) frame = true;
+			else if (task) currentTask = task;
+			else break;
+		}
+
+		if (frame) {
+			{
+				PROFILE_ZONE("RenderThread::replay");
+				replaying.execute();
+			}
+			{
+				PROFILE_ZONE("RenderThread::swap");
+				glfwSwapBuffers(window);
+			}
+
+			std::lock_guard<std::mutex> lock(mtx);
+			framePending = false;
+		}
+		else {
+			PROFILE_ZONE("RenderThread::task");
+			(*currentTask)();
+
+			std::lock_guard<std::mutex> lock(mtx);
+			task = nullptr;
+		}
+		cv.notify_all();
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+// Owns the GL context on a dedicated thread
+// The main thread records each frame into a CommandBuffer and hands it over with submit(),
+// so input, the gui and scene logic never wait on the driver
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "CommandBuffer.h"
+
+class RenderThread {
+public:
+	RenderThread() = default;
+	~RenderThread();
+
+	// the context must be current on the calling thread, it is moved to the render thread
+	void start(GLFWwindow* window);
+	// finish outstanding work and make the context current on the calling thread again
+	void stop();
+
+	bool isRunning() const { return running; }
+
+	// hand over a recorded frame, replayed and presented on the render thread
+	// waits for the previous frame first; commands comes back as an empty buffer to record the next frame into
+	void submit(CommandBuffer& commands);
+
+	// block until the last submitted frame has been replayed
+	void waitIdle();
+
+	// run one-off GL work (loading, resizing, shader reloads) on the render thread and wait for it
+	// runs inline when the thread is not running, the context is current on the caller then
+	void run(const std::function<void()>& fn);
+
+private:
+	GLFWwindow* window = nullptr;
+	std::thread thread;
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool running = false;
+
+	CommandBuffer replaying;	// owned by the render thread while framePending
+	bool framePending = false;
+	const std::function<void()>* task = nullptr;
+
+	void threadLoop();
+
+	// prevent copying
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+};
\ No newline at end of file
@@ -1,93 +1,578 @@
 #include "Renderer.h"
+#include "lights/DirectionalLight.h"
+#include "HardwareCounters.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <threadpool.h>
+
+// texture units
+// albedo: 0, normal: 1, metrough: 2, ao: 3, emissive: 4
+static constexpr int SHADOW_MAP_UNIT = 5;
+static constexpr int PREFILTER_MAP_UNIT = 6;
+static constexpr int BRDF_LUT_UNIT = 7;
+
+static bool hasExtension(const char* name) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+		const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (ext && std::strcmp(ext, name) == 0) return true;
+	}
+	return false;
+}
+
+// conservative box vs clip volume test; false only if all 8 corners are outside the same plane
+// the near plane can be skipped for passes that clamp depth instead of clipping
+static bool intersectsClipVolume(const glm::mat4& mvp, const glm::vec3& bmin, const glm::vec3& bmax, bool testNear = true) {
+	int outside[6] = { 0 };
+	for (int i = 0; i < 8; i++) {
+		glm::vec3 corner(
+			(i & 1) ? bmax.x : bmin.x,
+			(i & 2) ? bmax.y : bmin.y,
+			(i & 4) ? bmax.z : bmin.z);
+		glm::vec4 clip = mvp * glm::vec4(corner, 1.0f);
+
+		if (clip.x < -clip.w) outside[0]++;
+		if (clip.x > clip.w) outside[1]++;
+		if (clip.y < -clip.w) outside[2]++;
+		if (clip.y > clip.w) outside[3]++;
+		if (clip.z < -clip.w) outside[4]++;
+		if (clip.z > clip.w) outside[5]++;
+	}
+
+	if (!testNear) outside[4] = 0;
+	for (int p = 0; p < 6; p++) {
+		if (outside[p] == 8) return false;
+	}
+	return true;
+}
+
+Renderer::~Renderer() {
+	release();
+}
+
+void Renderer::release() {
+	destroyTargets();
+	if (fullscreenVAO) glDeleteVertexArrays(1, &fullscreenVAO);
+	if (shadowMaps) {
+		resources.release(ResourceRegistry::Kind::Texture, shadowMaps);
+		glDeleteTextures(1, &shadowMaps);
+	}
+	if (shadowFBO) glDeleteFramebuffers(1, &shadowFBO);
+	fullscreenVAO = shadowMaps = shadowFBO = 0;
+	gpuProfiler.release();
+
+	streamBuffer.destroy();
+	shadowShader.reset();
+	prepassShader.reset();
+	oitCompositeShader.reset();
+}
+
+const char* Renderer::passName(int pass) {
+	switch (pass) {
+	case PASS_SHADOW: return "Shadows";
+	case PASS_PREPASS: return "Depth Pre-pass";
+	case PASS_SKYBOX: return "Skybox";
+	case PASS_OPAQUE: return "Opaque";
+	case PASS_TRANSPARENT: return "Transparent";
+	case PASS_GUI: return "GUI";
+	default: return "Unknown";
+	}
+}
 
 void Renderer::init(const Scene& scene) {
 	// if we need to pre-bake anything, we do it here
+
+	// shadows
+	// layers are routed from the vertex shader when supported, otherwise through a geometry stage
+	layeredVertexShader = hasExtension("GL_ARB_shader_viewport_layer_array");
+	if (layeredVertexShader) {
+		shadowShader = std::make_shared<Shader>(SHADER_DIR "shadow_layered.vert", SHADER_DIR "depth.frag");
+	}
+	else {
+		logger.warning("GL_ARB_shader_viewport_layer_array not supported, using geometry shader for shadow layers");
+		shadowShader = std::make_shared<Shader>(SHADER_DIR "shadow_layered_gs.vert", SHADER_DIR "shadow_layered.geom", SHADER_DIR "depth.frag");
+	}
+
+	createShadowMaps(shadowResolution);
+
+	// depth pre-pass
+	prepassShader = std::make_shared<Shader>(SHADER_DIR "prepass.vert", SHADER_DIR "depth.frag");
+
+	// streamed per frame data
+	streamBuffer.init(STREAM_REGION_SIZE);
+
+	// OIT composite, drawn as a fullscreen triangle
+	oitCompositeShader = std::make_shared<Shader>(SHADER_DIR "fullscreen.vert", SHADER_DIR "oit_composite.frag");
+	glGenVertexArrays(1, &fullscreenVAO);
+
+	// pass timers, registered in Pass order so a pass is its own scope id
+	gpuProfiler.init();
+	if (gpuProfiler.scopeCount() == 0) {
+		for (int pass = 0; pass < PASS_COUNT; pass++) gpuProfiler.addScope(passName(pass));
+	}
+}
+
+void Renderer::destroyTargets() {
+	for (unsigned int tex : { sceneColor, sceneDepth, oitAccum, oitRevealage }) {
+		resources.release(ResourceRegistry::Kind::Texture, tex);
+	}
+
+	if (sceneFBO) glDeleteFramebuffers(1, &sceneFBO);
+	if (sceneColor) glDeleteTextures(1, &sceneColor);
+	if (sceneDepth) glDeleteTextures(1, &sceneDepth);
+	if (oitFBO) glDeleteFramebuffers(1, &oitFBO);
+	if (oitAccum) glDeleteTextures(1, &oitAccum);
+	if (oitRevealage) glDeleteTextures(1, &oitRevealage);
+	sceneFBO = sceneColor = sceneDepth = 0;
+	oitFBO = oitAccum = oitRevealage = 0;
+}
+
+static unsigned int createTargetTexture(GLenum internalFormat, GLenum format, GLenum type, int width, int height, size_t texelBytes, const char* label) {
+	unsigned int tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	resources.track(ResourceRegistry::Kind::Texture, tex, ResourceRegistry::Category::RenderTarget,
+		ResourceRegistry::textureBytes(width, height, texelBytes), 0, label);
+	return tex;
+}
+
+void Renderer::resize(int w, int h) {
+	if (w <= 0 || h <= 0) return; // minimized
+	outputWidth = w;
+	outputHeight = h;
+	updateTargets();
 }
 
-void Renderer::render(const Scene& scene) {
-	renderSkybox(scene);
+static int scaledSize(int size, float scale) {
+	return std::max(1, static_cast<int>(size * scale + 0.5f));
+}
 
-	commands.clear();
-	collectDrawCommands(scene);
-	executeBatched(scene);
+bool Renderer::targetsOutdated() const {
+	if (outputWidth == 0) return false; // no size yet
+	return shadowResolution != shadowMapResolution
+		|| scaledSize(outputWidth, renderScale) != width
+		|| scaledSize(outputHeight, renderScale) != height;
 }
 
-void Renderer::collectDrawCommands(const Scene& scene) {
+void Renderer::updateTargets() {
+	if (shadowResolution != shadowMapResolution) createShadowMaps(shadowResolution);
+	if (outputWidth == 0) return;
+
+	int w = scaledSize(outputWidth, renderScale);
+	int h = scaledSize(outputHeight, renderScale);
+	if (w == width && h == height && sceneFBO) return;
+
+	destroyTargets();
+	width = w;
+	height = h;
+
+	// scene color + depth
+	sceneColor = createTargetTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height, 4, "scene color");
+	sceneDepth = createTargetTexture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height, 4, "scene depth");
+
+	glGenFramebuffers(1, &sceneFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		logger.error("scene framebuffer is incomplete");
+	}
+
+	// OIT accumulation + revealage
+	oitAccum = createTargetTexture(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, width, height, 8, "OIT accumulation");
+	oitRevealage = createTargetTexture(GL_R8, GL_RED, GL_UNSIGNED_BYTE, width, height, 1, "OIT revealage");
+
+	glGenFramebuffers(1, &oitFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, oitFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, oitAccum, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, oitRevealage, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+	const GLenum oitBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, oitBuffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		logger.error("OIT framebuffer is incomplete");
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Renderer::readSceneColor(std::vector<unsigned char>& rgb, int& outWidth, int& outHeight) const {
+	outWidth = width;
+	outHeight = height;
+	rgb.clear();
+	if (!sceneFBO) return;
+
+	rgb.resize(static_cast<size_t>(width) * height * 3);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void Renderer::prepare(const Scene& scene, FrameSnapshot& frame) {
+	PROFILE_ZONE("Renderer::prepare");
+
+	// the last prepare's scratch is no longer referenced, snapshots only hold plain vectors
+	frameArena.reset();
+
+	frame.view = scene.camera.getViewMatrix();
+	frame.projection = scene.camera.getProjectionMatrix();
+	frame.viewPos = scene.camera.position;
+	frame.transparencyMode = transparencyMode;
+
+	collectMeshUploads(scene, frame);
+	collectDrawCommands(scene, frame);
+	collectDirLights(scene, frame);
+	{
+		PROFILE_ZONE("LightClusters::build");
+		lightClusters.build(scene, frame.lightClusters, frameArena.shared());
+	}
+	frameArenaUsed = frameArena.used();
+}
+
+void Renderer::submit(const Scene& scene, const FrameSnapshot& frame, CommandBuffer& cmd) {
+	if (!sceneFBO) return;
+	PROFILE_ZONE("Renderer::submit");
+
+	gpuProfiler.beginFrame(cmd);
+
+	streamBuffer.beginFrame();
+
+	const auto& clusters = frame.lightClusters;
+	// the cluster grid is laid over the render target, which is smaller than the window when scaled
+	FrameUniforms frameUniforms = {
+		frame.view, frame.projection, frame.viewPos, textureLodBias,
+		glm::vec2(width, height), clusters.nearPlane, clusters.farPlane,
+		shadowPcfRadius
+	};
+	streamUniforms(cmd, FRAME_UNIFORMS_BINDING, frameUniforms);
+
+	// image based lighting, the same for every draw
+	// the coefficients never leave the GPU, a skybox load rewrites the buffer in place
+	if (scene.skybox) {
+		cmd.bindBufferBase(GL_SHADER_STORAGE_BUFFER, Skybox::IRRADIANCE_SH_BINDING, scene.skybox->m_IrradianceSH);
+		cmd.bindTexture(PREFILTER_MAP_UNIT, GL_TEXTURE_CUBE_MAP, scene.skybox->m_PrefilterMap);
+		cmd.bindTexture(BRDF_LUT_UNIT, GL_TEXTURE_2D, scene.skybox->m_BrdfLUT);
+		RENDER_STAT_ADD(TextureBinds, 2);
+	}
+
+	lightClusters.upload(cmd, streamBuffer, frame.lightClusters);
+	uploadMeshes(cmd, frame);
+	clusteredLightCount = frame.lightClusters.lightCount();
+	clusterIndexCount = frame.lightClusters.indexCount();
+
+	beginPass(cmd, PASS_SHADOW);
+	renderShadows(cmd, frame);
+	endPass(cmd, PASS_SHADOW);
+
+	cmd.bindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+	cmd.viewport(0, 0, width, height);
+	cmd.clearColor(glm::vec4(0.05f, 0.05f, 0.05f, 1.0f));
+	cmd.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	if (depthPrepass) {
+		beginPass(cmd, PASS_PREPASS);
+		renderDepthPrepass(cmd, frame);
+		endPass(cmd, PASS_PREPASS);
+	}
+
+	// with a pre-pass the skybox only fills pixels left at the far plane
+	beginPass(cmd, PASS_SKYBOX);
+	renderSkybox(cmd, scene, frame);
+	endPass(cmd, PASS_SKYBOX);
+
+	// opaque geometry only passes where it matches the pre-pass depth exactly
+	if (depthPrepass) {
+		cmd.depthFunc(GL_EQUAL);
+		cmd.depthMask(false);
+	}
+
+	beginPass(cmd, PASS_OPAQUE);
+	executeBatched(cmd, scene, frame, 0, frame.firstTransparent);
+	endPass(cmd, PASS_OPAQUE);
+
+	if (depthPrepass) {
+		cmd.depthFunc(GL_LESS);
+		cmd.depthMask(true);
+	}
+
+	beginPass(cmd, PASS_TRANSPARENT);
+	renderTransparent(cmd, scene, frame);
+	endPass(cmd, PASS_TRANSPARENT);
+
+	// present
+	if (presentToScreen) {
+		cmd.bindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+		cmd.bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		bool scaled = width != outputWidth || height != outputHeight;
+		cmd.blitFramebuffer(width, height, outputWidth, outputHeight, GL_COLOR_BUFFER_BIT, scaled ? GL_LINEAR : GL_NEAREST);
+	}
+	cmd.bindFramebuffer(GL_FRAMEBUFFER, 0);
+	cmd.viewport(0, 0, outputWidth, outputHeight);
+
+	streamBytesUsed = streamBuffer.used();
+	streamBuffer.endFrame(cmd);
+}
+
+bool Renderer::shadersChanged(const Scene& scene) const {
+	for (const auto& shader : { shadowShader, prepassShader, oitCompositeShader }) {
+		if (shader && shader->sourcesChanged()) return true;
+	}
+	if (scene.skybox && scene.skybox->m_SkyboxShader && scene.skybox->m_SkyboxShader->sourcesChanged()) return true;
+
 	for (const auto& object : scene.objects) {
-		if (!object->material->shader || object->material->shader->ID == 0) continue;
+		const auto& shader = object->material->shader;
+		if (shader && shader->sourcesChanged()) return true;
+	}
+	return false;
+}
 
-		float distance = glm::length(scene.camera.position - object->transform.position);
-		glm::mat4 modelMatrix = object->transform.getModelMatrix();
+void Renderer::reloadShaders(const Scene& scene) {
+	for (const auto& shader : { shadowShader, prepassShader, oitCompositeShader }) {
+		if (shader) shader->checkHotReload();
+	}
+	if (scene.skybox && scene.skybox->m_SkyboxShader) scene.skybox->m_SkyboxShader->checkHotReload();
 
-		for (const auto& mesh : object->meshes) {
-			commands.push_back({
-				mesh.get(),
-				object->material.get(),
-				modelMatrix,
-				distance
-				});
-		}
+	// materials share shaders, checkHotReload is a no-op once a shader is up to date
+	for (const auto& object : scene.objects) {
+		const auto& shader = object->material->shader;
+		if (shader) shader->checkHotReload();
 	}
+}
 
-	// TODO: group by same texture
+void Renderer::syncStats() {
+	gpuProfiler.collect();
+	renderStats.endFrame();
+}
 
-	// sort
-	std::sort(commands.begin(), commands.end(),
-		[](const DrawCommand& a, const DrawCommand& b) {
-			if (a.material->isTransparent != b.material->isTransparent) {
-				return a.material->isTransparent;
-			}
+// opaque:		0 | shader | texture | depth, grouped by state then front to back
+// transparent:	1 | ~depth (back to front) when sorted, 1 | shader | texture with OIT
+static uint64_t makeSortKey(const Material& material, const Mesh& mesh, float distance, float farPlane, bool sortTransparentByDepth) {
+	uint64_t depth = static_cast<uint64_t>(glm::clamp(distance / farPlane, 0.0f, 1.0f) * 65535.0f);
+	// keyed on the Shader object rather than its GL id, which hot reload may change on the GL thread mid prepare
+	uint64_t shader = (reinterpret_cast<uintptr_t>(material.shader.get()) >> 4) & 0xFFFF;
+	uint64_t texture = mesh.texIndices.empty() ? 0 : ((mesh.texIndices[0] + 1) & 0xFFFF);
 
-			if (a.material->shader != b.material->shader) {
-				return a.material->shader < b.material->shader;
-			}
+	if (!material.isTransparent) {
+		return (shader << 32) | (texture << 16) | depth;
+	}
+	if (sortTransparentByDepth) {
+		return (1ull << 63) | (0xFFFF - depth);
+	}
+	return (1ull << 63) | (shader << 32) | (texture << 16);
+}
 
-			if (!a.mesh->texIndices.empty() && !b.mesh->texIndices.empty()) {
-				return a.mesh->texIndices[0] < b.mesh->texIndices[0];
+void Renderer::collectDrawCommands(const Scene& scene, FrameSnapshot& frame) {
+	PROFILE_ZONE("Renderer::collectDrawCommands");
+
+	auto& commands = frame.commands;
+	auto& shadowCasters = frame.shadowCasters;
+
+	// per chunk output, each chunk allocates from its own arena
+	// small scenes may use fewer chunks than there are threads, those stay empty
+	const unsigned int threads = threadPool.size();
+	LinearArena& scratch = frameArena.shared();
+	ArenaVector<ArenaVector<DrawCommand>> workerCommands(ArenaAllocator<ArenaVector<DrawCommand>>{ scratch });
+	ArenaVector<ArenaVector<DrawCommand>> workerCasters(ArenaAllocator<ArenaVector<DrawCommand>>{ scratch });
+	workerCommands.reserve(threads);
+	workerCasters.reserve(threads);
+	for (unsigned int i = 0; i < threads; i++) {
+		workerCommands.emplace_back(ArenaAllocator<DrawCommand>{ frameArena.worker(i) });
+		workerCasters.emplace_back(ArenaAllocator<DrawCommand>{ frameArena.worker(i) });
+	}
+
+	const glm::mat4 viewProjection = frame.projection * frame.view;
+	const glm::vec3 cameraPos = frame.viewPos;
+	const float farPlane = scene.camera.farPlane;
+	const bool sortTransparentByDepth = frame.transparencyMode == TransparencyMode::Sorted;
+
+	// each worker culls its slice of the objects into its own buffer and sorts it
+	// objects are only touched by one worker, so the transform cache needs no locking
+	threadPool.parallelFor(scene.objects.size(), 256, [&](unsigned int chunk, size_t begin, size_t end) {
+		PROFILE_ZONE("Renderer::cullChunk");
+		auto& local = workerCommands[chunk];
+		auto& casters = workerCasters[chunk];
+
+		for (size_t i = begin; i < end; i++) {
+			const auto& object = scene.objects[i];
+			if (!object->material->shader) continue;
+
+			float distance = glm::length(cameraPos - object->transform.position);
+			glm::mat4 modelMatrix = object->transform.getModelMatrix();
+			glm::mat4 mvp = viewProjection * modelMatrix;
+
+			for (const auto& mesh : object->meshes) {
+				if (mesh->indexCount == 0) continue;
+
+				DrawCommand cmd = {
+					mesh.get(),
+					object->material.get(),
+					modelMatrix,
+					distance,
+					makeSortKey(*object->material, *mesh, distance, farPlane, sortTransparentByDepth),
+					static_cast<int>(mesh->indexCount),
+					mesh->boundsMin,
+					mesh->boundsMax
+				};
+
+				if (intersectsClipVolume(mvp, mesh->boundsMin, mesh->boundsMax)) {
+					local.push_back(cmd);
+				}
+				else if (!object->material->isTransparent) {
+					casters.push_back(cmd);
+				}
 			}
+		}
+
+		PROFILE_ZONE_COUNTERS("Renderer::sortChunk");
+		std::sort(local.begin(), local.end(),
+			[](const DrawCommand& a, const DrawCommand& b) { return a.sortKey < b.sortKey; });
+	});
 
-			return false;
+	// lay the sorted runs out back to back
+	ArenaVector<size_t> runOffsets(ArenaAllocator<size_t>{ scratch });
+	runOffsets.reserve(threads + 1);
+	runOffsets.push_back(0);
+	for (unsigned int i = 0; i < threads; i++) {
+		runOffsets.push_back(runOffsets.back() + workerCommands[i].size());
+	}
+	const size_t total = runOffsets.back();
+	commands.resize(total);
+
+	shadowCasters.clear();
+	for (unsigned int i = 0; i < threads; i++) {
+		shadowCasters.insert(shadowCasters.end(), workerCasters[i].begin(), workerCasters[i].end());
+	}
+
+	// merge neighbouring runs pairwise, in parallel, until one run is left
+	// the passes ping-pong between two arena buffers and the last one writes straight into commands
+	static_assert(std::is_trivially_copyable<DrawCommand>::value, "merged in uninitialized arena memory");
+	DrawCommand* src = threads > 1 ? scratch.allocate<DrawCommand>(total) : commands.data();
+	DrawCommand* dst = threads > 2 ? scratch.allocate<DrawCommand>(total) : commands.data();
+	for (unsigned int i = 0; i < threads; i++) {
+		std::copy(workerCommands[i].begin(), workerCommands[i].end(), src + runOffsets[i]);
+	}
+
+	for (size_t width = 1; width < threads; width *= 2) {
+		size_t pairs = (threads + 2 * width - 1) / (2 * width);
+		if (width * 2 >= threads) dst = commands.data();
+
+		threadPool.parallelFor(pairs, 1, [&](unsigned int, size_t begin, size_t end) {
+			for (size_t p = begin; p < end; p++) {
+				size_t first = runOffsets[std::min<size_t>(p * 2 * width, threads)];
+				size_t middle = runOffsets[std::min<size_t>(p * 2 * width + width, threads)];
+				size_t last = runOffsets[std::min<size_t>(p * 2 * width + 2 * width, threads)];
+
+				std::merge(src + first, src + middle, src + middle, src + last, dst + first,
+					[](const DrawCommand& a, const DrawCommand& b) { return a.sortKey < b.sortKey; });
+			}
 		});
+		std::swap(src, dst);
+	}
+
+	frame.firstTransparent = std::partition_point(commands.begin(), commands.end(),
+		[](const DrawCommand& cmd) { return !cmd.material->isTransparent; }) - commands.begin();
 }
 
-void Renderer::executeBatched(const Scene& scene) {
-	if (commands.empty()) return;
+void Renderer::collectDirLights(const Scene& scene, FrameSnapshot& frame) {
+	// hand out shadow layers to directional lights
+	frame.dirLightCount = 0;
+	for (const auto& light : scene.lights) {
+		auto dir = std::dynamic_pointer_cast<DirectionalLight>(light);
+		if (!dir) continue;
+
+		if (frame.dirLightCount == MAX_SHADOW_LAYERS) {
+			dir->shadowArrayLayer = -1;
+			continue;
+		}
+
+		dir->shadowArrayLayer = frame.dirLightCount;
+		frame.dirLights[frame.dirLightCount++] = { dir->direction, dir->color, dir->lightSpaceMatrix };
+	}
+}
+
+void Renderer::collectMeshUploads(const Scene& scene, FrameSnapshot& frame) {
+	frame.meshUploads.clear();
+	frame.meshStaging.clear();
+
+	// room for every dirty mesh to send all of its storage, so how much changes from frame to frame never grows these
+	size_t uploads = 0;
+	size_t bytes = 0;
+	for (const auto& object : scene.objects) {
+		for (const auto& mesh : object->meshes) {
+			if (!mesh->isDirty()) continue;
+			uploads += Mesh::maxUploads();
+			bytes += mesh->maxUploadBytes();
+		}
+	}
+	frame.meshUploads.reserve(uploads);
+	frame.meshStaging.reserve(bytes);
+
+	for (const auto& object : scene.objects) {
+		for (const auto& mesh : object->meshes) {
+			if (mesh->isDirty()) mesh->collectUploads(frame.meshUploads, frame.meshStaging);
+		}
+	}
+}
+
+void Renderer::uploadMeshes(CommandBuffer& cmd, const FrameSnapshot& frame) {
+	meshUploadBytes = 0;
+
+	// recorded before any pass, so every draw of the frame sees the new data
+	for (const auto& upload : frame.meshUploads) {
+		if (upload.reallocate) cmd.bufferData(upload.buffer, upload.reallocate, GL_DYNAMIC_DRAW);
+		if (upload.size == 0) continue;
+
+		// staged in the ring and copied on the GPU, only when the ring is full does the data go inline
+		const unsigned char* data = frame.meshStaging.data() + upload.dataOffset;
+		auto a = streamBuffer.write(data, upload.size, 16);
+		if (a.ptr) cmd.copyBufferSubData(streamBuffer.id(), upload.buffer, a.offset, upload.offset, upload.size);
+		else cmd.bufferSubData(upload.buffer, upload.offset, data, upload.size);
+		meshUploadBytes += upload.size;
+	}
+}
+
+void Renderer::executeBatched(CommandBuffer& cmd, const Scene& scene, const FrameSnapshot& frame, size_t begin, size_t end, bool oitPass) {
+	if (begin >= end) return;
+	PROFILE_ZONE("Renderer::executeBatched");
 
 	// TODO: resolve the dereference pointer call
 	Shader* shader = nullptr;
 
-	for (const auto& cmd : commands) {
-		if (!cmd.material || !cmd.material->shader) continue;
+	for (size_t i = begin; i < end; i++) {
+		const auto& draw = frame.commands[i];
+		if (!draw.material || !draw.material->shader || draw.material->shader->ID == 0) continue;
 
-		if (shader != cmd.material->shader.get()) {
+		if (shader != draw.material->shader.get()) {
 			// shader switching logic
 			// the idea behind this is we only switch the shader only when we need to
-			shader = cmd.material->shader.get();
+			shader = draw.material->shader.get();
 
-			shader->checkHotReload();
-			shader->use();
+			shader->use(cmd);
 
-			shader->setMat4("view", scene.camera.getViewMatrix());
-			shader->setMat4("projection", scene.camera.getProjectionMatrix());
-			shader->setVec3("viewPos", scene.camera.position);
+			bindLights(cmd, frame, *shader);
+			shader->setBool(cmd, "oitPass", oitPass);
 		}
 
-		shader->setMat4("model", cmd.modelMatrix);
-		shader->setVec4("p_albedo", cmd.material->albedo);
-		shader->setFloat("p_metalness", cmd.material->metalness);
-		shader->setFloat("p_roughness", cmd.material->roughness);
-
-		shader->setBool("hasAlbedoMap", false);
+		DrawUniforms uniforms = { draw.modelMatrix, draw.material->albedo, draw.material->metalness, draw.material->roughness, 0, 0.0f };
 
 		// textures
-		for (int texIdx : cmd.mesh->texIndices) {
+		for (int texIdx : draw.mesh->texIndices) {
 			const auto& tex = scene.textures[texIdx];
 			
 			switch (tex->type) {
 			case Texture::Type::ALBEDO:
-				shader->setBool("hasAlbedoMap", true);
-				shader->setInt("albedoMap", 0);
-				tex->bind(0);
+				uniforms.hasAlbedoMap = 1;
+				shader->setInt(cmd, "albedoMap", 0);
+				tex->bind(cmd, 0);
 				break;
 
 			// albedo: 0
@@ -98,16 +583,202 @@ void Renderer::executeBatched(const Scene& scene) {
 			}
 		}
 
-		cmd.mesh->render();
+		if (!streamUniforms(cmd, DRAW_UNIFORMS_BINDING, uniforms)) continue;
+		cmd.drawElements(draw.mesh->VAO, draw.indexCount);
+		RENDER_STAT_DRAW(draw.indexCount, 1);
 	}
 }
 
-void Renderer::renderSkybox(const Scene& scene) {
-	scene.skybox->m_SkyboxShader->checkHotReload();
+void Renderer::renderDepthPrepass(CommandBuffer& cmd, const FrameSnapshot& frame) {
+	if (frame.firstTransparent == 0) return;
+
+	prepassShader->use(cmd);
+
+	// depth only, position-only shader
+	cmd.colorMask(false);
+
+	for (size_t i = 0; i < frame.firstTransparent; i++) {
+		const auto& draw = frame.commands[i];
+		DrawUniforms uniforms = { draw.modelMatrix, glm::vec4(1.0f), 0.0f, 0.0f, 0, 0.0f };
+		if (!streamUniforms(cmd, DRAW_UNIFORMS_BINDING, uniforms)) continue;
+		cmd.drawElements(draw.mesh->VAO, draw.indexCount);
+		RENDER_STAT_DRAW(draw.indexCount, 1);
+	}
+
+	cmd.colorMask(true);
+}
+
+void Renderer::renderTransparent(CommandBuffer& cmd, const Scene& scene, const FrameSnapshot& frame) {
+	if (frame.firstTransparent == frame.commands.size()) return;
+
+	if (frame.transparencyMode == TransparencyMode::Sorted) {
+		executeBatched(cmd, scene, frame, frame.firstTransparent, frame.commands.size());
+		return;
+	}
+
+	// weighted blended OIT
+	// accumulate every transparent fragment in one unsorted pass, tested against the opaque depth
+	cmd.bindFramebuffer(GL_FRAMEBUFFER, oitFBO);
+	cmd.clearBuffer(0, glm::vec4(0.0f));
+	cmd.clearBuffer(1, glm::vec4(1.0f));
+
+	cmd.depthMask(false);
+	cmd.blendFunci(0, GL_ONE, GL_ONE);
+	cmd.blendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+
+	executeBatched(cmd, scene, frame, frame.firstTransparent, frame.commands.size(), true);
+
+	// composite over the opaque image
+	cmd.bindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+	cmd.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	cmd.disable(GL_DEPTH_TEST);
+
+	oitCompositeShader->use(cmd);
+	oitCompositeShader->setInt(cmd, "accumTex", 0);
+	oitCompositeShader->setInt(cmd, "revealageTex", 1);
+	cmd.bindTexture(0, GL_TEXTURE_2D, oitAccum);
+	cmd.bindTexture(1, GL_TEXTURE_2D, oitRevealage);
+	RENDER_STAT_ADD(TextureBinds, 2);
+
+	cmd.drawArrays(fullscreenVAO, GL_TRIANGLES, 0, 3);
+	RENDER_STAT_DRAW(3, 1);
+
+	cmd.enable(GL_DEPTH_TEST);
+	cmd.depthMask(true);
+}
+
+void Renderer::renderSkybox(CommandBuffer& cmd, const Scene& scene, const FrameSnapshot& frame) {
 	if (scene.skybox) {
-		scene.skybox->draw(scene.camera.getViewMatrix(), scene.camera.getProjectionMatrix(), scene.camera.position);
+		scene.skybox->draw(cmd, frame.view, frame.projection, frame.viewPos);
 	}
 	else {
 		logger.error("no skybox to render");
 	}
+}
+
+void Renderer::createShadowMaps(int resolution) {
+	if (shadowMaps) {
+		resources.release(ResourceRegistry::Kind::Texture, shadowMaps);
+		glDeleteTextures(1, &shadowMaps);
+	}
+	if (!shadowFBO) glGenFramebuffers(1, &shadowFBO);
+
+	// one depth layer per directional light
+	glGenTextures(1, &shadowMaps);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMaps);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, resolution, resolution, MAX_SHADOW_LAYERS, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	resources.track(ResourceRegistry::Kind::Texture, shadowMaps, ResourceRegistry::Category::RenderTarget,
+		ResourceRegistry::textureBytes(resolution, resolution, 4, MAX_SHADOW_LAYERS), 0, "shadow maps");
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	float border[] = { 1.0f, 1.0f, 1.0f, 1.0f }; // outside the map = lit
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+
+	// attaching without a layer makes the framebuffer layered, gl_Layer picks the target
+	glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMaps, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		logger.error("shadow framebuffer is incomplete");
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	shadowMapResolution = resolution;
+}
+
+// uniform names of the directional light arrays, built once so binding lights doesn't format strings every frame
+struct DirLightUniformNames {
+	std::string direction[Renderer::MAX_SHADOW_LAYERS];
+	std::string color[Renderer::MAX_SHADOW_LAYERS];
+	std::string lightSpaceMatrix[Renderer::MAX_SHADOW_LAYERS];
+};
+
+static const DirLightUniformNames& dirLightUniformNames() {
+	static const DirLightUniformNames names = [] {
+		DirLightUniformNames n;
+		for (int i = 0; i < Renderer::MAX_SHADOW_LAYERS; i++) {
+			std::string idx = std::to_string(i);
+			n.direction[i] = "dirLights[" + idx + "].direction";
+			n.color[i] = "dirLights[" + idx + "].color";
+			n.lightSpaceMatrix[i] = "lightSpaceMatrices[" + idx + "]";
+		}
+		return n;
+	}();
+	return names;
+}
+
+void Renderer::renderShadows(CommandBuffer& cmd, const FrameSnapshot& frame) {
+	const int shadowLayerCount = frame.dirLightCount;
+	if (shadowLayerCount == 0) return;
+
+	// cleared even without casters, the lit passes still sample every layer
+	cmd.bindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+	cmd.viewport(0, 0, shadowMapResolution, shadowMapResolution);
+	cmd.clear(GL_DEPTH_BUFFER_BIT);
+	if (frame.firstTransparent == 0 && frame.shadowCasters.empty()) {
+		cmd.bindFramebuffer(GL_FRAMEBUFFER, 0);
+		return;
+	}
+
+	const auto& names = dirLightUniformNames();
+	shadowShader->use(cmd);
+	for (int i = 0; i < shadowLayerCount; i++) {
+		shadowShader->setMat4(cmd, names.lightSpaceMatrix[i].c_str(), frame.dirLights[i].lightSpaceMatrix);
+	}
+
+	// casters in front of the light's near plane are clamped instead of clipped
+	cmd.enable(GL_DEPTH_CLAMP);
+
+	// each mesh is submitted once and instanced across the layers it lands in
+	// so traversal and vertex fetch are no longer paid per light
+	// casters outside the camera frustum are kept in their own list
+	auto drawCaster = [&](const DrawCommand& draw) {
+		ShadowDrawUniforms uniforms = { draw.modelMatrix, {} };
+		int visibleLayers = 0;
+		for (int layer = 0; layer < shadowLayerCount; layer++) {
+			glm::mat4 mvp = frame.dirLights[layer].lightSpaceMatrix * draw.modelMatrix;
+			if (intersectsClipVolume(mvp, draw.boundsMin, draw.boundsMax, false)) {
+				uniforms.layerIndices[visibleLayers / 4][visibleLayers % 4] = layer;
+				visibleLayers++;
+			}
+		}
+		if (visibleLayers == 0) return;
+
+		if (!streamUniforms(cmd, DRAW_UNIFORMS_BINDING, uniforms)) return;
+		cmd.drawElements(draw.mesh->VAO, draw.indexCount, visibleLayers);
+		RENDER_STAT_DRAW(draw.indexCount, visibleLayers);
+	};
+
+	// transparent objects don't cast shadows
+	for (size_t i = 0; i < frame.firstTransparent; i++) drawCaster(frame.commands[i]);
+	for (const auto& draw : frame.shadowCasters) drawCaster(draw);
+
+	cmd.disable(GL_DEPTH_CLAMP);
+	cmd.bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Renderer::bindLights(CommandBuffer& cmd, const FrameSnapshot& frame, const Shader& shader) {
+	// light index == shadow layer, see collectDirLights()
+	const auto& names = dirLightUniformNames();
+	for (int i = 0; i < frame.dirLightCount; i++) {
+		shader.setVec3(cmd, names.direction[i].c_str(), frame.dirLights[i].direction);
+		shader.setVec3(cmd, names.color[i].c_str(), frame.dirLights[i].color);
+		shader.setMat4(cmd, names.lightSpaceMatrix[i].c_str(), frame.dirLights[i].lightSpaceMatrix);
+	}
+	shader.setInt(cmd, "numDirLights", frame.dirLightCount);
+
+	// point/spot lights come from the cluster SSBOs, their parameters from the frame block
+
+	shader.setInt(cmd, "shadowMaps", SHADOW_MAP_UNIT);
+	cmd.bindTexture(SHADOW_MAP_UNIT, GL_TEXTURE_2D_ARRAY, shadowMaps);
+	RENDER_STAT_ADD(TextureBinds, 1);
+
+	// bound once per frame in submit()
+	shader.setInt(cmd, "prefilterMap", PREFILTER_MAP_UNIT);
+	shader.setInt(cmd, "brdfLUT", BRDF_LUT_UNIT);
 }
\ No newline at end of file
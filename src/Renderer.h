@@ -3,24 +3,217 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 #include "Scene.h"
+#include "LightClusters.h"
+#include "CommandBuffer.h"
+#include "StreamBuffer.h"
+#include "GpuProfiler.h"
+#include "RenderStats.h"
+#include "FrameArena.h"
 
 class Renderer {
 public:
-	void init(const Scene& scene);
-	void render(const Scene& scene);
+	static constexpr int MAX_SHADOW_LAYERS = 8; // matches lightSpaceMatrices[8] in model.frag
+
+	enum class TransparencyMode { Sorted, WeightedBlended };
 
-private:
 	struct DrawCommand {
 		const Mesh* mesh;
 		const Material* material;
 		glm::mat4 modelMatrix;
-		float distance; // need to find a better approach for transparency
+		float distance; // camera distance, orders blended transparency
+		uint64_t sortKey;
+
+		// copied from the mesh, dynamic meshes may be edited while this frame is submitted
+		int indexCount;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	struct DirLightData {
+		glm::vec3 direction;
+		glm::vec3 color;
+		glm::mat4 lightSpaceMatrix;
+	};
+
+	// everything submit() needs from the scene for one frame
+	// built by prepare() and only read afterwards, so one can be submitted while the next is prepared
+	struct FrameSnapshot {
+		glm::mat4 view = glm::mat4(1.0f);
+		glm::mat4 projection = glm::mat4(1.0f);
+		glm::vec3 viewPos = glm::vec3(0.0f);
+
+		std::vector<DrawCommand> commands;		// camera visible, sorted by sortKey
+		std::vector<DrawCommand> shadowCasters;	// opaque but outside the camera, still needed by the shadow pass
+		size_t firstTransparent = 0; // commands are sorted opaque first
+
+		// shadowed directional lights, index == shadow layer
+		DirLightData dirLights[MAX_SHADOW_LAYERS];
+		int dirLightCount = 0;
+
+		LightClusters::Frame lightClusters;
+
+		// dynamic mesh edits since the last prepare, the bytes are staged here until submit streams them
+		std::vector<Mesh::Upload> meshUploads;
+		std::vector<unsigned char> meshStaging;
+
+		TransparencyMode transparencyMode = TransparencyMode::Sorted; // the commands were sorted for this mode
+	};
+
+	~Renderer();
+
+	void init(const Scene& scene);
+
+	// free the GL objects, the context must still be current (the destructor may run after it is gone)
+	void release();
+
+	// CPU only, no GL calls, so it can run on another thread while the last snapshot is submitted
+	// the scene must not be modified while this runs
+	void prepare(const Scene& scene, FrameSnapshot& frame);
+
+	// record the GL work for a snapshot into cmd, no GL calls itself
+	// the scene is only used for resources (textures, skybox), everything per frame comes from the snapshot
+	void submit(const Scene& scene, const FrameSnapshot& frame, CommandBuffer& cmd);
+
+	// hot reload, the file checks don't need the context but the recompile does
+	bool shadersChanged(const Scene& scene) const;
+	void reloadShaders(const Scene& scene);
+
+	// pick up what the GL thread measured, call while no recorded frame is being replayed
+	void syncStats();
+
+	// (re)creates the offscreen targets, call whenever the framebuffer size changes
+	void resize(int width, int height);
+
+	// the settings below that size GPU targets (renderScale, shadowResolution) take effect in updateTargets()
+	// checking is CPU only, updating needs the context
+	bool targetsOutdated() const;
+	void updateTargets();
+
+	// the scene is drawn at renderScale * framebuffer size and stretched on present
+	float renderScale = 1.0f;
+
+	// copy the scene to the default framebuffer at the end of the frame, off when running headless
+	bool presentToScreen = true;
+
+	// read the scene color target back as tightly packed RGB8 rows (bottom up), needs the context
+	void readSceneColor(std::vector<unsigned char>& rgb, int& outWidth, int& outHeight) const;
+
+	// shadows
+	int shadowResolution = 2048;
+	int shadowPcfRadius = 1; // (2r+1)^2 taps, 0 = hard shadows
+
+	// added to the mip level picked for material textures, positive is blurrier and cheaper
+	float textureLodBias = 0.0f;
+
+	// lay down opaque depth first so the main pass shades each pixel once
+	bool depthPrepass = false;
+
+	// transparency
+	TransparencyMode transparencyMode = TransparencyMode::Sorted;
+
+	// render passes, timed on the GPU, the pass is the profiler scope id
+	// the gui is drawn by the app after submit(), it wraps it in PASS_GUI itself
+	enum Pass { PASS_SHADOW, PASS_PREPASS, PASS_SKYBOX, PASS_OPAQUE, PASS_TRANSPARENT, PASS_GUI, PASS_COUNT };
+	static const char* passName(int pass);
+	void beginPass(CommandBuffer& cmd, Pass pass) { gpuProfiler.begin(cmd, pass); }
+	void endPass(CommandBuffer& cmd, Pass pass) { gpuProfiler.end(cmd, pass); }
+	GpuProfiler gpuProfiler;
+
+	// stats of the last submitted frame
+	int clusteredLightCount = 0;
+	int clusterIndexCount = 0;
+	size_t streamBytesUsed = 0;
+	size_t meshUploadBytes = 0;
+	size_t streamRegionSize() const { return streamBuffer.regionSize(); }
+	size_t frameArenaUsed = 0;
+	size_t frameArenaCapacity() const { return frameArena.capacity(); }
+
+private:
+	// scratch of prepare(), everything in it is dropped when the next prepare() starts
+	FrameArena frameArena;
+
+	// the scene is rendered offscreen, then copied to the default framebuffer
+	int outputWidth = 0;
+	int outputHeight = 0;
+	int width = 0; // scene target size, output size * renderScale
+	int height = 0;
+	unsigned int sceneFBO = 0;
+	unsigned int sceneColor = 0;
+	unsigned int sceneDepth = 0;
+
+	// weighted blended OIT, shares sceneDepth so transparents are tested against opaque geometry
+	unsigned int oitFBO = 0;
+	unsigned int oitAccum = 0;
+	unsigned int oitRevealage = 0;
+	std::shared_ptr<Shader> oitCompositeShader;
+	unsigned int fullscreenVAO = 0;
+
+	// shadow map array, one layer per directional light
+	unsigned int shadowFBO = 0;
+	unsigned int shadowMaps = 0;
+	int shadowMapResolution = 0;
+	std::shared_ptr<Shader> shadowShader;
+	bool layeredVertexShader = false; // GL_ARB_shader_viewport_layer_array, otherwise geometry shader fallback
+
+	std::shared_ptr<Shader> prepassShader;
+
+	// point/spot lights, binned per frame
+	LightClusters lightClusters;
+
+	// per frame and per draw data is written straight into a persistently mapped ring
+	static constexpr size_t STREAM_REGION_SIZE = 8 << 20;
+	StreamBuffer streamBuffer;
+
+	// std140 uniform blocks, keep in sync with the shaders
+	static constexpr unsigned int FRAME_UNIFORMS_BINDING = 0;
+	static constexpr unsigned int DRAW_UNIFORMS_BINDING = 1;
+
+	struct FrameUniforms { // FrameData
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec3 viewPos;
+		float textureLodBias;
+		glm::vec2 clusterScreenSize;
+		float clusterNear;
+		float clusterFar;
+		int32_t shadowPcfRadius;
+		int32_t pad0[3];
+	};
+	struct DrawUniforms { // DrawData
+		glm::mat4 model;
+		glm::vec4 albedo;
+		float metalness;
+		float roughness;
+		uint32_t hasAlbedoMap;
+		float pad0;
 	};
+	struct ShadowDrawUniforms { // ShadowDrawData
+		glm::mat4 model;
+		glm::ivec4 layerIndices[MAX_SHADOW_LAYERS / 4];
+	};
+
+	template<typename T>
+	bool streamUniforms(CommandBuffer& cmd, unsigned int binding, const T& block) {
+		auto a = streamBuffer.write(block, streamBuffer.uniformAlignment);
+		if (!a.ptr) return false; // ring full, skip the draw
+		RENDER_STAT_ADD(UniformBlocks, 1);
+		cmd.bindBufferRange(GL_UNIFORM_BUFFER, binding, streamBuffer.id(), a.offset, a.size);
+		return true;
+	}
 
-	std::vector<DrawCommand> commands;
+	void collectDrawCommands(const Scene& scene, FrameSnapshot& frame);
+	void collectDirLights(const Scene& scene, FrameSnapshot& frame);
+	void collectMeshUploads(const Scene& scene, FrameSnapshot& frame);
+	void uploadMeshes(CommandBuffer& cmd, const FrameSnapshot& frame);
+	void executeBatched(CommandBuffer& cmd, const Scene& scene, const FrameSnapshot& frame, size_t begin, size_t end, bool oitPass = false);
+	void renderSkybox(CommandBuffer& cmd, const Scene& scene, const FrameSnapshot& frame);
+	void renderDepthPrepass(CommandBuffer& cmd, const FrameSnapshot& frame);
+	void renderTransparent(CommandBuffer& cmd, const Scene& scene, const FrameSnapshot& frame);
+	void destroyTargets();
 
-	void collectDrawCommands(const Scene& scene);
-	void executeBatched(const Scene& scene);
-	void renderSkybox(const Scene& scene);
+	void createShadowMaps(int resolution);
+	void renderShadows(CommandBuffer& cmd, const FrameSnapshot& frame);
+	void bindLights(CommandBuffer& cmd, const FrameSnapshot& frame, const Shader& shader);
 };
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "ResourceRegistry.h"
+
+#include <logger.h>
+#include <algorithm>
+
+static const char* kindName(ResourceRegistry::Kind kind) {
+	switch (kind) {
+	case ResourceRegistry::Kind::Buffer: return "buffer";
+	case ResourceRegistry::Kind::Texture: return "texture";
+	case ResourceRegistry::Kind::Renderbuffer: return "renderbuffer";
+	default: return "object";
+	}
+}
+
+const char* ResourceRegistry::categoryName(Category category) {
+	switch (category) {
+	case Category::Mesh: return "Meshes";
+	case Category::Texture: return "Textures";
+	case Category::Environment: return "Environment";
+	case Category::RenderTarget: return "Render targets";
+	case Category::Buffer: return "Buffers";
+	default: return "Unknown";
+	}
+}
+
+void ResourceRegistry::track(Kind kind, unsigned int name, Category category, size_t gpuBytes, size_t cpuBytes, const std::string& label) {
+	if (name == 0) return;
+
+	std::lock_guard<std::mutex> lock(mtx);
+	auto it = entries.find(key(kind, name));
+	if (it != entries.end()) {
+		// re-registered, e.g. a mesh that grew or dropped its CPU copy
+		Totals& old = categoryTotals[static_cast<int>(it->second.category)];
+		old.gpuBytes -= it->second.gpuBytes;
+		old.cpuBytes -= it->second.cpuBytes;
+		old.count--;
+		it->second = { kind, name, category, gpuBytes, cpuBytes, label };
+	}
+	else {
+		entries.emplace(key(kind, name), Entry{ kind, name, category, gpuBytes, cpuBytes, label });
+	}
+
+	Totals& totals = categoryTotals[static_cast<int>(category)];
+	totals.gpuBytes += gpuBytes;
+	totals.cpuBytes += cpuBytes;
+	totals.count++;
+}
+
+void ResourceRegistry::release(Kind kind, unsigned int name) {
+	if (name == 0) return;
+
+	std::lock_guard<std::mutex> lock(mtx);
+	auto it = entries.find(key(kind, name));
+	if (it == entries.end()) return;
+
+	Totals& totals = categoryTotals[static_cast<int>(it->second.category)];
+	totals.gpuBytes -= it->second.gpuBytes;
+	totals.cpuBytes -= it->second.cpuBytes;
+	totals.count--;
+	entries.erase(it);
+}
+
+ResourceRegistry::Totals ResourceRegistry::totals(Category category) const {
+	std::lock_guard<std::mutex> lock(mtx);
+	return categoryTotals[static_cast<int>(category)];
+}
+
+ResourceRegistry::Totals ResourceRegistry::totals() const {
+	std::lock_guard<std::mutex> lock(mtx);
+	Totals sum;
+	for (const Totals& t : categoryTotals) {
+		sum.gpuBytes += t.gpuBytes;
+		sum.cpuBytes += t.cpuBytes;
+		sum.count += t.count;
+	}
+	return sum;
+}
+
+void ResourceRegistry::topConsumers(std::vector<Entry>& out, size_t count) const {
+	out.clear();
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		out.reserve(entries.size());
+		for (const auto& [k, entry] : entries) out.push_back(entry);
+	}
+
+	auto bigger = [](const Entry& a, const Entry& b) { return a.gpuBytes + a.cpuBytes > b.gpuBytes + b.cpuBytes; };
+	if (out.size() > count) {
+		std::partial_sort(out.begin(), out.begin() + count, out.end(), bigger);
+		out.resize(count);
+	}
+	else {
+		std::sort(out.begin(), out.end(), bigger);
+	}
+}
+
+size_t ResourceRegistry::reportLeaks() const {
+	std::lock_guard<std::mutex> lock(mtx);
+	if (entries.empty()) {
+		logger.info("all tracked GPU resources were released");
+		return 0;
+	}
+
+	size_t bytes = 0;
+	for (const auto& [k, entry] : entries) {
+		logger.error(std::string("leaked ") + kindName(entry.kind) + " " + std::to_string(entry.name) + " (" + categoryName(entry.category) + ", "
+			+ std::to_string(entry.gpuBytes / 1024) + " KB): " + entry.label);
+		bytes += entry.gpuBytes;
+	}
+	logger.error(std::to_string(entries.size()) + " GPU resources were never released (" + std::to_string(bytes / 1024) + " KB)");
+	return entries.size();
+}
+
+size_t ResourceRegistry::textureBytes(int width, int height, size_t bytesPerTexel, int layers, bool mipmapped) {
+	size_t bytes = 0;
+	for (;;) {
+		bytes += static_cast<size_t>(width) * height * bytesPerTexel * layers;
+		if (!mipmapped || (width == 1 && height == 1)) break;
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	return bytes;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+// Book-keeping for GPU allocations and the CPU copies that shadow them
+// Every path that creates GL storage reports here, the gui shows totals and top consumers
+// and whatever is still registered at shutdown was never released
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+class ResourceRegistry {
+public:
+	enum class Category { Mesh, Texture, Environment, RenderTarget, Buffer, COUNT };
+	static const char* categoryName(Category category);
+
+	// GL names are only unique per object type
+	enum class Kind : uint8_t { Buffer, Texture, Renderbuffer };
+
+	struct Entry {
+		Kind kind;
+		unsigned int name;
+		Category category;
+		size_t gpuBytes;
+		size_t cpuBytes;
+		std::string label;
+	};
+
+	struct Totals {
+		size_t gpuBytes = 0;
+		size_t cpuBytes = 0;
+		int count = 0;
+	};
+
+	static ResourceRegistry& instance() {
+		static ResourceRegistry registry;
+		return registry;
+	}
+
+	// register an object, or update it if it is already known; sizes are absolute, not deltas
+	// safe from any thread (meshes grow on the prepare thread)
+	void track(Kind kind, unsigned int name, Category category, size_t gpuBytes, size_t cpuBytes, const std::string& label);
+	void release(Kind kind, unsigned int name);
+
+	Totals totals(Category category) const;
+	Totals totals() const;
+
+	// the largest entries by GPU + CPU bytes, biggest first
+	void topConsumers(std::vector<Entry>& out, size_t count) const;
+
+	// log everything still registered, returns how many there were
+	// call once every owner should be gone (but before the context is)
+	size_t reportLeaks() const;
+
+	// storage of a 2D texture (or array), the mip chain adds about a third
+	static size_t textureBytes(int width, int height, size_t bytesPerTexel, int layers = 1, bool mipmapped = false);
+
+private:
+	ResourceRegistry() = default;
+
+	// prevent copying
+	ResourceRegistry(const ResourceRegistry&) = delete;
+	ResourceRegistry& operator=(const ResourceRegistry&) = delete;
+
+	static uint64_t key(Kind kind, unsigned int name) { return (static_cast<uint64_t>(kind) << 32) | name; }
+
+	mutable std::mutex mtx;
+	std::unordered_map<uint64_t, Entry> entries;
+	Totals categoryTotals[static_cast<int>(Category::COUNT)];
+};
+
+// declare global
+inline ResourceRegistry& resources = ResourceRegistry::instance();
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Scene.h"
+#include "CpuProfiler.h"
 #include "lights/DirectionalLight.h"
 
 // TODO: REFACTOR THIS CONSTRUCTOR
@@ -9,6 +10,8 @@ void Scene::setSkybox(const std::string& hdriPath) {
 }
 
 void Scene::update(float deltaTime) {
+	PROFILE_ZONE("Scene::update");
+
 	// update transforms
 	for (auto& object : objects) {
 		object->update(deltaTime);
@@ -23,6 +26,7 @@ void Scene::update(float deltaTime) {
 		if (auto dir = std::dynamic_pointer_cast<DirectionalLight>(light)) {
 			glm::mat3 rotY = glm::rotate(glm::mat4(1.0f), step, glm::vec3(0, 1, 0));
 			dir->direction = glm::normalize(rotY * dir->direction);
+			dir->updateLightSpaceMatrix();
 		}
 	}
 }
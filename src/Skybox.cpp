@@ -1,73 +1,135 @@
 #include "Skybox.h"
+#include "HardwareCounters.h"
+#include "SphericalHarmonics.h"
+#include "IblCache.h"
 #include <stb_image.h>
+#include <chrono>
 
-Skybox::Skybox() : m_CubemapID(0), m_SkyboxVAO(0), m_SkyboxVBO(0) {
+// sh_project.comp, a workgroup covers a 64x64 tile of one face and writes 10 partials
+static constexpr int SH_TILE_SIZE = 64;
+static constexpr int SH_PARTIALS_PER_GROUP = 10;
+
+static constexpr int ENVIRONMENT_SIZE = 1024;
+
+// prefiltered specular cubemap, roughness goes from 0 to 1 over the mips
+static constexpr int PREFILTER_SIZE = 512;
+static constexpr int PREFILTER_MIPS = 6;
+
+// split sum BRDF, NdotV along x and roughness along y
+static constexpr int BRDF_LUT_SIZE = 512;
+
+// what a bake depends on besides its source and shaders, hashed into the cache key so no padding
+struct BakeParams {
+	int32_t environmentSize;
+	int32_t prefilterSize;
+	int32_t prefilterMips;
+	int32_t gpuIrradiance; // the CPU projection gives slightly different coefficients
+};
+
+Skybox::Skybox() : m_CubemapID(0), m_PrefilterMap(0), m_IrradianceSH(0), m_BrdfLUT(0), m_SkyboxVAO(0), m_SkyboxVBO(0) {
 	setupGeometry();
 	m_SkyboxShader = std::make_shared<Shader>(SHADER_DIR "skybox.vert", SHADER_DIR "skybox.frag");
 	m_EquiToCubeShader = std::make_shared<Shader>(SHADER_DIR "equi_to_cube.vert", SHADER_DIR "equi_to_cube.frag");
-	m_PrefilterShader = std::make_shared<Shader>(SHADER_DIR "prefilter.vert", SHADER_DIR "prefilter.frag");
+	m_PrefilterShader = std::make_shared<Shader>(SHADER_DIR "prefilter.comp");
+
+	// the CPU projection still works without these
+	try {
+		m_SHProjectShader = std::make_shared<Shader>(SHADER_DIR "sh_project.comp");
+		m_SHReduceShader = std::make_shared<Shader>(SHADER_DIR "sh_reduce.comp");
+	}
+	catch (const ShaderException&) {
+		logger.warning("SH compute shaders unavailable, projecting irradiance on the CPU");
+		m_SHProjectShader.reset();
+		m_SHReduceShader.reset();
+	}
+
+	// zeros until the first HDRI is baked, so the model shaders read no ambient instead of garbage
+	glm::vec4 zero[9] = {};
+	glCreateBuffers(1, &m_IrradianceSH);
+	glNamedBufferStorage(m_IrradianceSH, sizeof(zero), zero, GL_DYNAMIC_STORAGE_BIT);
+	resources.track(ResourceRegistry::Kind::Buffer, m_IrradianceSH, ResourceRegistry::Category::Environment, sizeof(zero), 0, "skybox irradiance SH");
 
 	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
+	computeBRDFLut();
+
 	// TODO: move this out of the constructor
 	load("assets/skybox/artist_workshop_4k.hdr");
 }
 
 Skybox::~Skybox() {
+	resources.release(ResourceRegistry::Kind::Buffer, m_SkyboxVBO);
+	resources.release(ResourceRegistry::Kind::Texture, m_CubemapID);
+	resources.release(ResourceRegistry::Kind::Texture, m_PrefilterMap);
+	resources.release(ResourceRegistry::Kind::Buffer, m_IrradianceSH);
+	resources.release(ResourceRegistry::Kind::Texture, m_BrdfLUT);
 	glDeleteVertexArrays(1, &m_SkyboxVAO);
 	glDeleteBuffers(1, &m_SkyboxVBO);
+	glDeleteBuffers(1, &m_IrradianceSH);
 	glDeleteTextures(1, &m_CubemapID);
+	if (m_PrefilterMap) glDeleteTextures(1, &m_PrefilterMap);
+	glDeleteTextures(1, &m_BrdfLUT);
 }
 
 void Skybox::load(const std::string& path) {
-	m_CubemapID = convertHDRItoCubemap(path);
-	glFinish();
+	PROFILE_ZONE("Skybox::load");
 
-	// may need to cleanup the old data?
-	// idk, we'll see how it pans out
+	auto start = std::chrono::steady_clock::now();
 
-	//computeIrradiance();
-	//computePrefilterMap();
-}
+	// a previously seen environment skips decoding and every bake
+	const BakeParams params = { ENVIRONMENT_SIZE, PREFILTER_SIZE, PREFILTER_MIPS, m_SHProjectShader && m_SHReduceShader };
+	uint64_t key = IblCache::key({ path, SHADER_DIR "equi_to_cube.vert", SHADER_DIR "equi_to_cube.frag",
+		SHADER_DIR "sh_project.comp", SHADER_DIR "sh_reduce.comp", SHADER_DIR "prefilter.comp" }, &params, sizeof(params));
+
+	IblBake bake;
+	if (key && m_Cache.load(key, ENVIRONMENT_SIZE, PREFILTER_SIZE, PREFILTER_MIPS, bake)) {
+		applyBake(bake, path);
+		float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		logger.info("loaded baked environment " + path + " from the cache in " + std::to_string(ms) + " ms");
+		return;
+	}
 
-unsigned int Skybox::convertHDRItoCubemap(const std::string& path) {
-	// load HDR image
+	// the source stays on the CPU until the irradiance is projected from it
 	int width, height, nrChannels;
-	float* data = stbi_loadf(path.c_str(), &width, &height, &nrChannels, 0);
-	unsigned int hdrTexture = 0;
+	float* data = stbi_loadf(path.c_str(), &width, &height, &nrChannels, 3);
+	if (!data) {
+		logger.error("Failed to load HDR: " + path);
+		return; // keep showing the old one
+	}
 
-	if (data) {
-		glGenTextures(1, &hdrTexture);
-		glBindTexture(GL_TEXTURE_2D, hdrTexture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data);
+	// no glFinish needed, later commands using the cubemap are ordered after the bake anyway
+	replaceCubemap(convertHDRItoCubemap(data, width, height, path));
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// both bakes read the new cubemap and stay on the GPU
+	computeIrradiance(data, width, height);
+	stbi_image_free(data);
+	computePrefilterMap();
 
-		stbi_image_free(data);
-	}
-	else {
-		logger.error("Failed to load HDR: " + path);
-		return 0;
+	// reading back waits for the bakes, only the first load of an environment pays for that
+	if (key) {
+		readBake(bake);
+		m_Cache.save(key, bake);
 	}
 
-	// setup framebuffers and cubemap texture
-	unsigned int captureFBO, captureRBO;
-	glGenFramebuffers(1, &captureFBO);
-	glGenRenderbuffers(1, &captureRBO);
+	float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	logger.info("baked environment " + path + " in " + std::to_string(ms) + " ms");
+}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 1024, 1024);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
+void Skybox::replaceCubemap(unsigned int cubemap) {
+	// frames recorded before this point were already replayed, nothing references the old cubemap anymore
+	if (m_CubemapID) {
+		resources.release(ResourceRegistry::Kind::Texture, m_CubemapID);
+		glDeleteTextures(1, &m_CubemapID);
+	}
+	m_CubemapID = cubemap;
+}
 
+unsigned int Skybox::createEnvironmentCubemap(const std::string& path) {
 	unsigned int envCubemap;
 	glGenTextures(1, &envCubemap);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 	for (unsigned int i = 0; i < 6; i++) {
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 1024, 1024, 0, GL_RGB, GL_FLOAT, nullptr);
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, ENVIRONMENT_SIZE, ENVIRONMENT_SIZE, 0, GL_RGB, GL_FLOAT, nullptr);
 	}
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -75,6 +137,100 @@ unsigned int Skybox::convertHDRItoCubemap(const std::string& path) {
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
+	// RGB16F is padded to 4 channels by most drivers
+	resources.track(ResourceRegistry::Kind::Texture, envCubemap, ResourceRegistry::Category::Environment,
+		ResourceRegistry::textureBytes(ENVIRONMENT_SIZE, ENVIRONMENT_SIZE, 8, 6), 0, "environment cubemap: " + path);
+	return envCubemap;
+}
+
+void Skybox::createPrefilterMap() {
+	// immutable storage, image stores need a sized 4 channel format
+	if (m_PrefilterMap) {
+		resources.release(ResourceRegistry::Kind::Texture, m_PrefilterMap);
+		glDeleteTextures(1, &m_PrefilterMap);
+	}
+	glGenTextures(1, &m_PrefilterMap);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, m_PrefilterMap);
+	glTexStorage2D(GL_TEXTURE_CUBE_MAP, PREFILTER_MIPS, GL_RGBA16F, PREFILTER_SIZE, PREFILTER_SIZE);
+
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	resources.track(ResourceRegistry::Kind::Texture, m_PrefilterMap, ResourceRegistry::Category::Environment,
+		ResourceRegistry::textureBytes(PREFILTER_SIZE, PREFILTER_SIZE, 8, 6, true), 0, "prefiltered environment");
+}
+
+void Skybox::applyBake(const IblBake& bake, const std::string& path) {
+	PROFILE_ZONE("Skybox::applyBake");
+
+	// the cache key covers the sizes, an entry never has different ones
+	unsigned int cubemap = createEnvironmentCubemap(path);
+	glTextureSubImage3D(cubemap, 0, 0, 0, 0, ENVIRONMENT_SIZE, ENVIRONMENT_SIZE, 6, GL_RGB, GL_HALF_FLOAT, bake.environment.data());
+	replaceCubemap(cubemap);
+
+	createPrefilterMap();
+	const uint16_t* texels = bake.prefilter.data();
+	for (int mip = 0; mip < PREFILTER_MIPS; mip++) {
+		int mipSize = PREFILTER_SIZE >> mip;
+		glTextureSubImage3D(m_PrefilterMap, mip, 0, 0, 0, mipSize, mipSize, 6, GL_RGBA, GL_HALF_FLOAT, texels);
+		texels += IblBake::environmentTexels(mipSize) * 4;
+	}
+
+	glNamedBufferSubData(m_IrradianceSH, 0, sizeof(bake.shCoefficients), bake.shCoefficients);
+}
+
+void Skybox::readBake(IblBake& bake) const {
+	PROFILE_ZONE("Skybox::readBake");
+
+	// the bakes wrote through image stores and an SSBO
+	glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	bake.environmentSize = ENVIRONMENT_SIZE;
+	bake.environment.resize(IblBake::environmentTexels(ENVIRONMENT_SIZE) * 3);
+	glGetTextureImage(m_CubemapID, 0, GL_RGB, GL_HALF_FLOAT, static_cast<GLsizei>(bake.environment.size() * sizeof(uint16_t)), bake.environment.data());
+
+	bake.prefilterSize = PREFILTER_SIZE;
+	bake.prefilterMips = PREFILTER_MIPS;
+	bake.prefilter.resize(IblBake::prefilterTexels(PREFILTER_SIZE, PREFILTER_MIPS) * 4);
+	uint16_t* texels = bake.prefilter.data();
+	for (int mip = 0; mip < PREFILTER_MIPS; mip++) {
+		size_t count = IblBake::environmentTexels(PREFILTER_SIZE >> mip) * 4;
+		glGetTextureImage(m_PrefilterMap, mip, GL_RGBA, GL_HALF_FLOAT, static_cast<GLsizei>(count * sizeof(uint16_t)), texels);
+		texels += count;
+	}
+
+	glGetNamedBufferSubData(m_IrradianceSH, 0, sizeof(bake.shCoefficients), bake.shCoefficients);
+}
+
+unsigned int Skybox::convertHDRItoCubemap(const float* data, int width, int height, const std::string& path) {
+	PROFILE_ZONE("Skybox::convertHDRItoCubemap");
+
+	// upload the HDR image
+	unsigned int hdrTexture = 0;
+	glGenTextures(1, &hdrTexture);
+	glBindTexture(GL_TEXTURE_2D, hdrTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// setup framebuffers and cubemap texture
+	unsigned int captureFBO, captureRBO;
+	glGenFramebuffers(1, &captureFBO);
+	glGenRenderbuffers(1, &captureRBO);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+	glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, ENVIRONMENT_SIZE, ENVIRONMENT_SIZE);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
+
+	unsigned int envCubemap = createEnvironmentCubemap(path);
+
 	// setup matrices for the faces
 	glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
 	glm::mat4 captureViews[] = {
@@ -97,7 +253,7 @@ unsigned int Skybox::convertHDRItoCubemap(const std::string& path) {
 	GLint viewport[4];
 	glGetIntegerv(GL_VIEWPORT, viewport);
 
-	glViewport(0, 0, 1024, 1024);
+	glViewport(0, 0, ENVIRONMENT_SIZE, ENVIRONMENT_SIZE);
 	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
 	for (unsigned int i = 0; i < 6; i++) {
 		m_EquiToCubeShader->setMat4("view", captureViews[i]);
@@ -118,21 +274,21 @@ unsigned int Skybox::convertHDRItoCubemap(const std::string& path) {
 	return envCubemap;
 }
 
-void Skybox::draw(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos) {
-	glDepthFunc(GL_LEQUAL); // this is important, pass if depth is 1.0
-	m_SkyboxShader->use();
+void Skybox::draw(CommandBuffer& cmd, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos) {
+	cmd.depthFunc(GL_LEQUAL); // this is important, pass if depth is 1.0
+	m_SkyboxShader->use(cmd);
 
 	// remove translation :)
 	glm::mat4 s_view = glm::mat4(glm::mat3(view));
 	
-	m_SkyboxShader->setMat4("view", s_view);
-	m_SkyboxShader->setMat4("projection", projection);
-
-	glBindVertexArray(m_SkyboxVAO);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_CubemapID);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glDepthFunc(GL_LESS);
+	m_SkyboxShader->setMat4(cmd, "view", s_view);
+	m_SkyboxShader->setMat4(cmd, "projection", projection);
+
+	cmd.bindTexture(0, GL_TEXTURE_CUBE_MAP, m_CubemapID);
+	cmd.drawArrays(m_SkyboxVAO, GL_TRIANGLES, 0, 36);
+	RENDER_STAT_ADD(TextureBinds, 1);
+	RENDER_STAT_DRAW(36, 1);
+	cmd.depthFunc(GL_LESS);
 }
 
 void Skybox::setupGeometry() {
@@ -156,198 +312,149 @@ void Skybox::setupGeometry() {
 	glBindVertexArray(m_SkyboxVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, m_SkyboxVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices, GL_STATIC_DRAW);
+	resources.track(ResourceRegistry::Kind::Buffer, m_SkyboxVBO, ResourceRegistry::Category::Buffer, sizeof(vertices), 0, "skybox cube");
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 }
 
-void Skybox::computeIrradiance() {
-	logger.info("computing irradiance map...");
-
-	shCoefficients.assign(9, glm::vec3(0.0f));
-
-	// read back the cubemap faces to the CPU to calculate
-	// todo: normally, this should be done via compute shader
-	// ill figure this out in the future when I get to it :)
-
-	int width = 1024;
-	int skip = 64; // refactor
-	std::vector<float> data(width * width * 3);
-	float totalWeight = 0.0f;
-
-	for (unsigned int face = 0; face < 6; ++face) {
-		glBindTexture(GL_TEXTURE_CUBE_MAP, m_CubemapID);
-		glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB, GL_FLOAT, data.data());
-
-		for (int y = 0; y < width; y += skip) {
-			for (int x = 0; x < width; x += skip) {
-				// get direction from face UV (yes really)
-				// https://en.wikipedia.org/wiki/Cube_mapping
-				float u = (x + 0.5f) / width * 2.0f - 1.0f;
-				float v = (y + 0.5f) / width * 2.0f - 1.0f;
-
-				glm::vec3 dir;
-				if (face == 0) dir = { 1, -v, -u };			// +X
-				else if (face == 1) dir = { -1, -v, u };	// -X
-				else if (face == 2) dir = { u, 1, v };		// +Y
-				else if (face == 3) dir = { u, -1, -v };	// -Y
-				else if (face == 4) dir = { u, -v, 1 };		// +Z
-				else if (face == 5) dir = { -u, -v, -1 };	// -Z
-				dir = glm::normalize(dir);
-
-				// solid angle weight
-				// https://en.wikipedia.org/wiki/Solid_angle
-				float diff = 1.0f + u * u + v * v;
-				float weight = 4.0f / (sqrt(diff) * diff);
-
-				glm::vec3 texel = glm::vec3(data[(y * width + x) * 3 + 0],
-					data[(y * width + x) * 3 + 1],
-					data[(y * width + x) * 3 + 2]);
-
-				texel = glm::clamp(texel, glm::vec3(0.0f), glm::vec3(1000.0f));
-
-				// project onto SH basis
-				float sh[9];
-				sh[0] = 0.282095f;
-				sh[1] = 0.488603f * dir.y;
-				sh[2] = 0.488603f * dir.z;
-				sh[3] = 0.488603f * dir.x;
-				sh[4] = 1.092548f * dir.x * dir.y;
-				sh[5] = 1.092548f * dir.y * dir.z;
-				sh[6] = 0.315392f * (3.0f * dir.z * dir.z - 1.0f);
-				sh[7] = 1.092548f * dir.x * dir.z;
-				sh[8] = 0.546274f * (dir.x * dir.x - dir.y * dir.y);
-
-				for (int i = 0; i < 9; ++i) {
-					shCoefficients[i] += texel * sh[i] * weight;
-				}
-				totalWeight += weight;
-			}
-		}
-	}
+void Skybox::computeIrradiance(const float* hdr, int width, int height) {
+	PROFILE_ZONE_COUNTERS("Skybox::computeIrradiance");
 
-	// normalize
-	for (int i = 0; i < 9; ++i) {
-		shCoefficients[i] *= (4.0f * 3.14159f) / totalWeight;
-	}
+	auto start = std::chrono::steady_clock::now();
 
-	logger.info("generated skybox irradiance");
-}
+	if (!m_SHProjectShader || !m_SHReduceShader) {
+		// every texel of the source on the thread pool, then a single upload
+		SH9 sh = SH9::projectEquirectangular(hdr, width, height);
+		glm::vec4 coefficients[9];
+		for (int i = 0; i < 9; i++) coefficients[i] = glm::vec4(sh.coefficients[i], 0.0f);
+		glNamedBufferSubData(m_IrradianceSH, 0, sizeof(coefficients), coefficients);
 
-void Skybox::computePrefilterMap() {
-	logger.info("computing prefilter map...");
-
-	// create cubemap that will store prefiltered mipmaps
-	// -> allocate cubemap
-	// -> gl_rgb16f
-	// -> generate multiple mipmap levels, glTexImage2D in a loop
-	// -> set filtering
-	//		-> gl linear mipmap linear
-	//		-> gl linear
-	//		-> gl clamp to edge
-
-	// create cubemap
-	glGenTextures(1, &m_PrefilterMap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_PrefilterMap);
-
-	for (unsigned int i = 0; i < 6; ++i) {
-		// faces of the cubemap
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
+		float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		logger.info("generated skybox irradiance from " + std::to_string(width) + "x" + std::to_string(height) + " texels in " + std::to_string(ms) + " ms");
+		return;
 	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+	// every texel of the cubemap, one workgroup per tile reduces its tile in shared memory,
+	// then a single workgroup reduces the tiles and writes the coefficients
+	int faceSize = 0;
+	glGetTextureLevelParameteriv(m_CubemapID, 0, GL_TEXTURE_WIDTH, &faceSize);
+	int tiles = (faceSize + SH_TILE_SIZE - 1) / SH_TILE_SIZE;
+	int groupCount = tiles * tiles * 6;
 
-	// setup framebuffer and renderbuffer
-	// -> fbo for rendering each face of the cube
-	// -> depth RBO
-	// -> bind FBO and attach RBO for depth
+	unsigned int partials = 0;
+	glCreateBuffers(1, &partials);
+	glNamedBufferStorage(partials, static_cast<GLsizeiptr>(groupCount) * SH_PARTIALS_PER_GROUP * sizeof(glm::vec4), nullptr, 0);
 
-	unsigned int captureFBO, captureRBO;
-	glGenFramebuffers(1, &captureFBO);
-	glGenRenderbuffers(1, &captureRBO);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, m_CubemapID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, partials);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, IRRADIANCE_SH_BINDING, m_IrradianceSH);
+
+	m_SHProjectShader->use();
+	m_SHProjectShader->setInt("environmentMap", 0);
+	m_SHProjectShader->setInt("faceSize", faceSize);
+	glDispatchCompute(tiles, tiles, 6);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	m_SHReduceShader->use();
+	m_SHReduceShader->setInt("groupCount", groupCount);
+	glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// deleting is deferred by the driver until the dispatches are done
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+	glDeleteBuffers(1, &partials);
+
+	// only the recording is timed, the work itself shows up in the GPU profiler of the next frame
+	float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	logger.info("dispatched skybox irradiance for " + std::to_string(faceSize) + "x" + std::to_string(faceSize) + " faces (" + std::to_string(groupCount) + " tiles) in " + std::to_string(ms) + " ms");
+}
 
-	// todo: this piece of code is used multiple times in different functions
-	//	I should move it and similar functions to a dedicated utilities file or even a class
-	glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-	glm::mat4 captureViews[] = {
-	   glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-	   glm::lookAt(glm::vec3(0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-	   glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
-	   glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
-	   glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-	   glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
-	};
+void Skybox::computePrefilterMap() {
+	PROFILE_ZONE("Skybox::computePrefilterMap");
 
+	auto start = std::chrono::steady_clock::now();
 
-	// use the prefilter shader
-	// bind cubemap
-	// set shader uniforms
-	//		-> environmentMap (reuse from the skybox albedo)
-	//		-> roughness
-	// activate
+	createPrefilterMap();
 
-	m_PrefilterShader->use();
-	m_PrefilterShader->setMat4("projection", captureProjection);
-	
 	// we want to generate the mipmaps using the existing albedo map
 	// as such, this function should only be called AFTER that is initialized
-	// same applies for the irradiance map
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, m_CubemapID);
 
+	m_PrefilterShader->use();
 	m_PrefilterShader->setInt("environmentMap", 0);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	unsigned int maxMipLevels = 6;
-
-	// render each mip level
-	// use viewport to mip resolution
+	// every mip is written directly, all 6 faces in one dispatch through a layered binding
+	for (int mip = 0; mip < PREFILTER_MIPS; mip++) {
+		int mipSize = PREFILTER_SIZE >> mip;
 
-	// after all faces and mips are rendered,
-	//		-> generate mipmaps if using glteximage2d
-	//		-> unbind framebuffer
+		// roughness level of the mip map is defined here
+		// we want to scale it based on the number of mip levels available
+		float roughness = static_cast<float>(mip) / static_cast<float>(PREFILTER_MIPS - 1);
+		m_PrefilterShader->setFloat("roughness", roughness);
+		m_PrefilterShader->setInt("mipSize", mipSize);
 
-	// backup viewport
-	// todo: figure out how to use multiple viewports, instead of reusing the default one
-	GLint viewport[4];
-	glGetIntegerv(GL_VIEWPORT, viewport);
+		glBindImageTexture(0, m_PrefilterMap, mip, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		int groups = (mipSize + 7) / 8;
+		glDispatchCompute(groups, groups, 6);
+	}
 
-	for (unsigned int mip = 0; mip < maxMipLevels; ++mip) {
-		// resize viewport to the mip level
-		unsigned int mipWidth = static_cast<unsigned int>(512 * std::pow(0.5, mip));
-		unsigned int mipHeight = static_cast<unsigned int>(512 * std::pow(0.5, mip));
+	// the model shaders sample it next
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
 
-		logger.info("calculating mip " + std::to_string(mip) + " (" + std::to_string(mipWidth) + "x" + std::to_string(mipHeight) + ")");
+	float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	logger.info("dispatched skybox prefilter map (" + std::to_string(PREFILTER_MIPS) + " mips) in " + std::to_string(ms) + " ms");
+}
 
-		glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-		glViewport(0, 0, mipWidth, mipHeight);
+void Skybox::computeBRDFLut() {
+	PROFILE_ZONE("Skybox::computeBRDFLut");
+
+	glGenTextures(1, &m_BrdfLUT);
+	glBindTexture(GL_TEXTURE_2D, m_BrdfLUT);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16F, BRDF_LUT_SIZE, BRDF_LUT_SIZE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	resources.track(ResourceRegistry::Kind::Texture, m_BrdfLUT, ResourceRegistry::Category::Environment,
+		ResourceRegistry::textureBytes(BRDF_LUT_SIZE, BRDF_LUT_SIZE, 4), 0, "BRDF LUT");
+
+	// the same for every environment, so it only depends on its size and shaders
+	const int32_t size = BRDF_LUT_SIZE;
+	uint64_t key = IblCache::key({ SHADER_DIR "fullscreen.vert", SHADER_DIR "brdf.frag" }, &size, sizeof(size));
+
+	std::vector<uint16_t> texels;
+	if (key && m_Cache.loadLUT(key, size, texels)) {
+		glTextureSubImage2D(m_BrdfLUT, 0, 0, 0, size, size, GL_RG, GL_HALF_FLOAT, texels.data());
+		return;
+	}
 
-		// roughness level of the mip map is defined here
-		// we want to scale it based on the number of mip levels available
-		float roughness = (float)mip / (float)(maxMipLevels - 1);
-		m_PrefilterShader->setFloat("roughness", roughness);
+	// one fullscreen triangle, the shader isn't needed after this
+	Shader brdfShader(SHADER_DIR "fullscreen.vert", SHADER_DIR "brdf.frag");
 
-		for (unsigned int i = 0; i < 6; ++i) {
-			m_PrefilterShader->setMat4("view", captureViews[i]);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, m_PrefilterMap, mip);
+	unsigned int captureFBO;
+	glGenFramebuffers(1, &captureFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_BrdfLUT, 0);
 
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glBindVertexArray(m_SkyboxVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-		}
-	}
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glViewport(0, 0, size, size);
 
-	logger.info("generated skybox prefilter map");
+	brdfShader.use();
+	glBindVertexArray(m_SkyboxVAO); // the triangle comes from gl_VertexID, any VAO does
+	glDrawArrays(GL_TRIANGLES, 0, 3);
 
-	// cleanup
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 	glDeleteFramebuffers(1, &captureFBO);
-	glDeleteRenderbuffers(1, &captureRBO);
+
+	if (key) {
+		texels.resize(static_cast<size_t>(size) * size * 2);
+		glGetTextureImage(m_BrdfLUT, 0, GL_RG, GL_HALF_FLOAT, static_cast<GLsizei>(texels.size() * sizeof(uint16_t)), texels.data());
+		m_Cache.saveLUT(key, size, texels);
+	}
+	logger.info("generated BRDF LUT");
 }
\ No newline at end of file
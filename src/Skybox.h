@@ -7,6 +7,8 @@
 #include <vector>
 
 #include "components/Shader.h"
+#include "ResourceRegistry.h"
+#include "IblCache.h"
 #include "logger.h"
 
 class Skybox {
@@ -15,12 +17,15 @@ public:
 	~Skybox();
 
 	void load(const std::string& path);
-	void draw(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos);
+	void draw(CommandBuffer& cmd, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos);
 
-	std::vector<glm::vec3> shCoefficients;
+	// SSBO binding of the irradiance, keep in sync with model.frag
+	static constexpr unsigned int IRRADIANCE_SH_BINDING = 4;
 
 	unsigned int m_CubemapID;		// base albedo map
 	unsigned int m_PrefilterMap;	// specular map
+	unsigned int m_IrradianceSH;	// diffuse irradiance, 9 vec4 SH coefficients (rgb) written on the GPU
+	unsigned int m_BrdfLUT;			// split sum scale (r) and bias (g), the same for every environment
 
 	std::shared_ptr<Shader> m_SkyboxShader;		// this is for rendering
 
@@ -28,14 +33,28 @@ private:
 	unsigned int m_SkyboxVAO;
 	unsigned int m_SkyboxVBO;
 
-	void setupGeometry();
-	unsigned int convertHDRItoCubemap(const std::string& path);
+	// baked products are cached on disk, see IblCache
+	IblCache m_Cache;
 
-	// IBL stuff
-	void computeIrradiance();
+	void setupGeometry();
+	unsigned int createEnvironmentCubemap(const std::string& path);
+	unsigned int convertHDRItoCubemap(const float* data, int width, int height, const std::string& path);
+	void replaceCubemap(unsigned int cubemap);
+
+	// IBL stuff, baked by compute shaders from the cubemap
+	// the source image is only used when the SH compute shaders are unavailable
+	void computeIrradiance(const float* hdr, int width, int height);
+	void createPrefilterMap();
 	void computePrefilterMap();
+	void computeBRDFLut();
+
+	// between the GPU and a cache entry
+	void applyBake(const IblBake& bake, const std::string& path);
+	void readBake(IblBake& bake) const;
 
 	// shaders
 	std::shared_ptr<Shader> m_EquiToCubeShader;	// this is for conversion
 	std::shared_ptr<Shader> m_PrefilterShader;	// specular mipmap generation
+	std::shared_ptr<Shader> m_SHProjectShader;	// per tile SH partials
+	std::shared_ptr<Shader> m_SHReduceShader;	// partials -> m_IrradianceSH
 };
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "SphericalHarmonics.h"
+#include "CpuProfiler.h"
+
+#include <threadpool.h>
+#include <algorithm>
+#include <vector>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SH_SSE 1
+#include <xmmintrin.h>
+#else
+#define SH_SSE 0
+#endif
+
+// Every texel of a row shares its latitude, so the basis splits into a latitude part and a longitude part.
+// x = r cos(phi), y = sin(lat), z = r sin(phi) with r = cos(lat), which leaves five longitude sums per row:
+// sum L, sum L cos, sum L sin, sum L sin^2, sum L sin cos (sum L cos^2 is the first minus the fourth)
+namespace {
+
+	constexpr float PI = 3.14159265358979f;
+
+	enum { SUM, COS, SIN, SIN2, SINCOS, SUM_COUNT };
+
+	// per column longitude terms, padded to a multiple of 4 with zeros
+	struct ColumnTables {
+		std::vector<float> terms[SUM_COUNT];
+	};
+
+	struct RowSums {
+		float values[SUM_COUNT][3] = {};
+	};
+
+	// what one chunk of rows adds up to, doubles so thousands of rows don't lose the small ones
+	struct Partial {
+		double coefficients[9][3] = {};
+		double weight = 0.0;
+	};
+
+	void sumRowScalar(const float* row, const ColumnTables& tables, int begin, int end, float maxRadiance, RowSums& sums) {
+		for (int x = begin; x < end; x++) {
+			for (int c = 0; c < 3; c++) {
+				float radiance = std::clamp(row[x * 3 + c], 0.0f, maxRadiance);
+				for (int s = 0; s < SUM_COUNT; s++) sums.values[s][c] += radiance * tables.terms[s][x];
+			}
+		}
+	}
+
+#if SH_SSE
+	void sumRow(const float* row, const ColumnTables& tables, int width, float maxRadiance, RowSums& sums) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 maxValue = _mm_set1_ps(maxRadiance);
+		__m128 acc[SUM_COUNT][3];
+		for (auto& sum : acc) sum[0] = sum[1] = sum[2] = zero;
+
+		int x = 0;
+		for (; x + 4 <= width; x += 4) {
+			// four RGB texels, r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3, turned into r, g and b lanes
+			const float* p = row + x * 3;
+			__m128 a = _mm_loadu_ps(p);
+			__m128 b = _mm_loadu_ps(p + 4);
+			__m128 c = _mm_loadu_ps(p + 8);
+
+			__m128 rgb[3];
+			rgb[0] = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 1, 0, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+			rgb[1] = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			rgb[2] = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+			for (auto& channel : rgb) channel = _mm_min_ps(_mm_max_ps(channel, zero), maxValue);
+
+			for (int s = 0; s < SUM_COUNT; s++) {
+				__m128 term = _mm_loadu_ps(&tables.terms[s][x]);
+				for (int ch = 0; ch < 3; ch++) acc[s][ch] = _mm_add_ps(acc[s][ch], _mm_mul_ps(rgb[ch], term));
+			}
+		}
+
+		alignas(16) float lanes[4];
+		for (int s = 0; s < SUM_COUNT; s++) {
+			for (int ch = 0; ch < 3; ch++) {
+				_mm_store_ps(lanes, acc[s][ch]);
+				sums.values[s][ch] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+			}
+		}
+
+		sumRowScalar(row, tables, x, width, maxRadiance, sums);
+	}
+#else
+	void sumRow(const float* row, const ColumnTables& tables, int width, float maxRadiance, RowSums& sums) {
+		sumRowScalar(row, tables, 0, width, maxRadiance, sums);
+	}
+#endif
+
+}
+
+SH9 SH9::projectEquirectangular(const float* rgb, int width, int height, float maxRadiance) {
+	PROFILE_ZONE("SH9::projectEquirectangular");
+
+	SH9 result;
+	if (!rgb || width <= 0 || height <= 0) return result;
+
+	// longitude of column i, matching sampleSphere() in equi_to_cube.frag: u = atan(z, x) / 2pi + 0.5
+	ColumnTables tables;
+	size_t padded = (static_cast<size_t>(width) + 3) & ~static_cast<size_t>(3);
+	for (auto& term : tables.terms) term.assign(padded, 0.0f);
+	for (int x = 0; x < width; x++) {
+		float phi = ((x + 0.5f) / width - 0.5f) * 2.0f * PI;
+		float c = std::cos(phi), s = std::sin(phi);
+		tables.terms[SUM][x] = 1.0f;
+		tables.terms[COS][x] = c;
+		tables.terms[SIN][x] = s;
+		tables.terms[SIN2][x] = s * s;
+		tables.terms[SINCOS][x] = s * c;
+	}
+
+	std::vector<Partial> partials(threadPool.size());
+	const float texelArea = (2.0f * PI / width) * (PI / height);
+
+	threadPool.parallelFor(static_cast<size_t>(height), 16, [&](unsigned int chunk, size_t begin, size_t end) {
+		Partial& partial = partials[chunk];
+
+		for (size_t row = begin; row < end; row++) {
+			// latitude of the row, v = asin(y) / pi + 0.5
+			float latitude = ((row + 0.5f) / height - 0.5f) * PI;
+			float y = std::sin(latitude);
+			float r = std::cos(latitude);
+			float weight = texelArea * r; // solid angle of each texel in the row
+
+			RowSums sums;
+			sumRow(rgb + row * static_cast<size_t>(width) * 3, tables, width, maxRadiance, sums);
+
+			for (int c = 0; c < 3; c++) {
+				float sum = sums.values[SUM][c];
+				float sumCos = sums.values[COS][c];
+				float sumSin = sums.values[SIN][c];
+				float sumSin2 = sums.values[SIN2][c];
+				float sumSinCos = sums.values[SINCOS][c];
+				float sumCos2 = sum - sumSin2;
+
+				// the same real basis as evaluateSHIrradiance() in model.frag
+				float projected[9] = {
+					0.282095f * sum,
+					0.488603f * y * sum,
+					0.488603f * r * sumSin,
+					0.488603f * r * sumCos,
+					1.092548f * r * y * sumCos,
+					1.092548f * r * y * sumSin,
+					0.315392f * (3.0f * r * r * sumSin2 - sum),
+					1.092548f * r * r * sumSinCos,
+					0.546274f * (r * r * sumCos2 - y * y * sum)
+				};
+				for (int i = 0; i < 9; i++) partial.coefficients[i][c] += static_cast<double>(projected[i]) * weight;
+			}
+			partial.weight += static_cast<double>(weight) * width;
+		}
+	});
+
+	Partial total;
+	for (const Partial& partial : partials) {
+		for (int i = 0; i < 9; i++)
+			for (int c = 0; c < 3; c++) total.coefficients[i][c] += partial.coefficients[i][c];
+		total.weight += partial.weight;
+	}
+
+	// the discrete weights only approximate the sphere, rescale them to exactly 4pi
+	double normalize = total.weight > 0.0 ? 4.0 * PI / total.weight : 0.0;
+	for (int i = 0; i < 9; i++) {
+		result.coefficients[i] = glm::vec3(
+			static_cast<float>(total.coefficients[i][0] * normalize),
+			static_cast<float>(total.coefficients[i][1] * normalize),
+			static_cast<float>(total.coefficients[i][2] * normalize));
+	}
+	return result;
+}
\ No newline at end of file
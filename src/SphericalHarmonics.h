@@ -0,0 +1,14 @@
+// Order 2 (9 coefficient) spherical harmonics projection of an environment, for diffuse irradiance
+// Works on the equirectangular HDR as loaded, so nothing has to be read back from the GPU
+#pragma once
+
+#include <glm/glm.hpp>
+
+struct SH9 {
+	glm::vec3 coefficients[9] = {};
+
+	// project every texel of a tightly packed RGB float equirectangular image, weighted by its solid angle
+	// rows are split over the thread pool and each row is summed four texels at a time (SSE when available)
+	// texels are clamped to maxRadiance so a few very bright ones (the sun) don't ring over the whole sphere
+	static SH9 projectEquirectangular(const float* rgb, int width, int height, float maxRadiance = 1000.0f);
+};
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "StreamBuffer.h"
+
+#include <logger.h>
+#include <algorithm>
+#include <string>
+
+StreamBuffer::~StreamBuffer() {
+	destroy();
+}
+
+void StreamBuffer::destroy() {
+	for (GLsync& fence : fences) {
+		if (fence) glDeleteSync(fence);
+		fence = nullptr;
+	}
+	if (buffer) {
+		resources.release(ResourceRegistry::Kind::Buffer, buffer);
+		glUnmapNamedBuffer(buffer);
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+	mapped = nullptr;
+}
+
+void StreamBuffer::init(size_t regionSize) {
+	size = regionSize;
+
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0) uniformAlignment = static_cast<size_t>(alignment);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0) storageAlignment = static_cast<size_t>(alignment);
+
+	// keep regions aligned for both kinds of binding
+	size_t regionAlign = std::max(uniformAlignment, storageAlignment);
+	size = (size + regionAlign - 1) / regionAlign * regionAlign;
+
+	// coherent, so writes become visible without explicit flushes
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, size * REGIONS, nullptr, flags);
+	mapped = static_cast<unsigned char*>(glMapNamedBufferRange(buffer, 0, size * REGIONS, flags));
+	resources.track(ResourceRegistry::Kind::Buffer, buffer, ResourceRegistry::Category::Buffer, size * REGIONS, 0, "stream ring");
+
+	if (!mapped) {
+		logger.error("failed to map stream buffer");
+	}
+}
+
+void StreamBuffer::beginFrame() {
+	region = (region + 1) % REGIONS;
+	head = 0;
+	overflowed = false;
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(size_t bytes, size_t alignment) {
+	Allocation a;
+	if (!mapped || bytes == 0) return a;
+
+	size_t start = (head + alignment - 1) / alignment * alignment;
+	if (start + bytes > size) {
+		if (!overflowed) {
+			logger.error("stream buffer region full (" + std::to_string(size / 1024) + " KB), dropping data this frame");
+			overflowed = true;
+		}
+		return a;
+	}
+
+	head = start + bytes;
+	a.offset = region * size + start;
+	a.ptr = mapped + a.offset;
+	a.size = bytes;
+	return a;
+}
+
+void StreamBuffer::endFrame(CommandBuffer& cmd) {
+	cmd.fenceSync(&fences[region]);
+
+	// the main thread records frame N+1 while frame N is replayed, so once this replay finishes
+	// the region of frame N+2 has to be free; with three regions that is the region of the previous frame
+	cmd.waitSync(&fences[(region + 2) % REGIONS]);
+}
\ No newline at end of file
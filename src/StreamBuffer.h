@@ -0,0 +1,70 @@
+// Persistently mapped ring buffer for data that changes every frame (uniform blocks, instance data, light lists)
+// The buffer is split into one region per frame in flight; the CPU writes straight into GPU visible memory
+// and each region is guarded by a fence, so the driver never has to synchronize behind our back
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstring>
+
+#include "CommandBuffer.h"
+#include "ResourceRegistry.h"
+
+class StreamBuffer {
+public:
+	static constexpr int REGIONS = 3;
+
+	struct Allocation {
+		void* ptr = nullptr;	// null when the region is full
+		size_t offset = 0;		// from the start of the buffer, for glBindBufferRange
+		size_t size = 0;
+	};
+
+	StreamBuffer() = default;
+	~StreamBuffer();
+
+	// create and map the buffer, needs the context
+	void init(size_t regionSize);
+	void destroy();
+
+	// start writing the next region, no GL calls
+	// the fence of that region was already waited on by an earlier endFrame(), see there
+	void beginFrame();
+
+	// sub-allocate from the current region, no GL calls
+	Allocation allocate(size_t size, size_t alignment);
+
+	// copy data into a fresh allocation
+	Allocation write(const void* data, size_t size, size_t alignment) {
+		Allocation a = allocate(size, alignment);
+		if (a.ptr) std::memcpy(a.ptr, data, size);
+		return a;
+	}
+	template<typename T>
+	Allocation write(const T& data, size_t alignment) { return write(&data, sizeof(T), alignment); }
+
+	// record the fence for this frame's region and the wait that makes the next region safe to write
+	void endFrame(CommandBuffer& cmd);
+
+	unsigned int id() const { return buffer; }
+	size_t regionSize() const { return size; }
+	size_t used() const { return head; }	// bytes allocated in the current region
+
+	// binding offset alignments, queried at init
+	size_t uniformAlignment = 256;
+	size_t storageAlignment = 256;
+
+private:
+	unsigned int buffer = 0;
+	unsigned char* mapped = nullptr;
+	size_t size = 0;	// per region
+	int region = REGIONS - 1;
+	size_t head = 0;
+	bool overflowed = false;
+
+	GLsync fences[REGIONS] = {};
+
+	// prevent copying
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+};
\ No newline at end of file
@@ -1,14 +1,19 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <string>
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <cstring>
 
 #include <logger.h>
+#include "../CommandBuffer.h"
+#include "../ResourceRegistry.h"
 
 class Mesh {
 public:
@@ -21,39 +26,134 @@ public:
 	};
 
 	// mesh attributes
+	// the CPU copies are only kept for dynamic meshes, static ones drop them once uploaded (see readback())
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	std::vector<int> texIndices;
 
+	// what the GPU buffers hold, valid with or without the CPU copies
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+
 	unsigned int VAO = 0;
 	unsigned int VBO = 0;
 	unsigned int EBO = 0;
 
+	// object space bounds, used for culling
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+
+	// a GPU side copy of a dirty range, collected by the thread that edits the mesh and recorded by the renderer
+	struct Upload {
+		unsigned int buffer;
+		size_t reallocate;	// new storage size in bytes, 0 keeps the current storage
+		size_t offset;		// destination, bytes
+		size_t size;		// bytes, may be 0 for a bare reallocation
+		size_t dataOffset;	// where the bytes are in the staging array
+	};
+
 	// constructors
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices) {
+	// dynamic meshes are expected to be edited after creation, they keep their CPU copies
+	// the name is only used for memory accounting
+	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, bool dynamic = false, const std::string& name = "mesh") {
 		this->vertices = std::move(vertices);
 		this->indices = std::move(indices);
+		this->dynamic = dynamic;
+		this->name = name;
+		computeBounds();
 		upload();
+		if (!dynamic) releaseCpuData();
 	}
 	~Mesh() {
+		resources.release(ResourceRegistry::Kind::Buffer, VBO);
 		if (EBO) glDeleteBuffers(1, &EBO);
 		if (VBO) glDeleteBuffers(1, &VBO);
 		if (VAO) glDeleteVertexArrays(1, &VAO);
 	}
 
-    // render our mesh
-    void render() const {
-        if (vertices.empty()) {
-            logger.error("MASH HAS NO VERTICES, CANNOT RENDER");
+    // dynamic updates
+    // edit vertices/indices in place (resizing is fine), then mark what changed
+    // only the dirty ranges are sent on the next frame, growing past the GPU storage reallocates it
+    // reserve the vectors before creating the mesh to size the storage for the largest it gets
+    // the CPU copies must be resident, call readback() first on a static mesh
+    void markVerticesDirty(size_t first, size_t count) {
+        if (!checkResident()) return;
+        markDirty(dirtyVertices, first, count);
+        // bounds only grow here, call computeBounds() after edits that shrink the mesh
+        for (size_t i = first; i < std::min(first + count, vertices.size()); i++) {
+            boundsMin = glm::min(boundsMin, vertices[i].pos);
+            boundsMax = glm::max(boundsMax, vertices[i].pos);
+        }
+    }
+    void markIndicesDirty(size_t first, size_t count) {
+        if (!checkResident()) return;
+        markDirty(dirtyIndices, first, count);
+    }
+    bool isDirty() const { return !dirtyVertices.empty() || !dirtyIndices.empty(); }
+
+    // the most collectUploads() can add in one call, so the caller can reserve before it
+    static size_t maxUploads() { return 2 * MAX_DIRTY_RANGES; }
+    size_t maxUploadBytes() const {
+        return std::max(vertices.size(), vertexCapacity) * sizeof(Vertex) + std::max(indices.size(), indexCapacity) * sizeof(unsigned int);
+    }
+
+    // turn the dirty ranges into uploads and clear them, CPU only
+    // must run on the thread that edits the mesh, the renderer does it in prepare()
+    void collectUploads(std::vector<Upload>& uploads, std::vector<unsigned char>& staging) {
+        collectBuffer(VBO, vertices, vertexCapacity, dirtyVertices, uploads, staging);
+        collectBuffer(EBO, indices, indexCapacity, dirtyIndices, uploads, staging);
+        // the CPU vectors can grow or shrink without the GPU storage changing
+        if (vertexCapacity != trackedVertexCapacity || indexCapacity != trackedIndexCapacity
+            || vertices.capacity() != trackedCpuVertices || indices.capacity() != trackedCpuIndices) {
+            trackMemory();
+        }
+        vertexCount = vertices.size();
+        indexCount = indices.size();
+    }
+
+    // residency
+    // the GPU buffers are the only copy of a static mesh, this frees the CPU side (pending edits are kept)
+    bool cpuResident() const { return resident; }
+    void releaseCpuData() {
+        if (isDirty()) {
+            logger.warning("mesh has edits that were not uploaded yet, keeping its CPU data");
             return;
         }
+        std::vector<Vertex>().swap(vertices);
+        std::vector<unsigned int>().swap(indices);
+        resident = false;
+        trackMemory();
+    }
+
+    // copy the GPU buffers back into vertices/indices, for tools that need the data (or to edit a static mesh)
+    // needs the context and blocks until the GPU is done with the buffers, so not something to do per frame
+    // run it where prepare() can't touch the mesh at the same time, e.g. through RenderThread::run
+    bool readback() {
+        if (resident) return true;
+        if (!glfwGetCurrentContext()) {
+            logger.error("mesh readback needs the GL context on the calling thread, go through RenderThread::run");
+            return false;
+        }
+        vertices.resize(vertexCount);
+        indices.resize(indexCount);
+        if (vertexCount) glGetNamedBufferSubData(VBO, 0, vertexCount * sizeof(Vertex), vertices.data());
+        if (indexCount) glGetNamedBufferSubData(EBO, 0, indexCount * sizeof(unsigned int), indices.data());
+        resident = true;
+        trackMemory();
+        return true;
+    }
+
+    void computeBounds() {
+        if (vertices.empty()) return;
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        boundsMin = boundsMax = vertices[0].pos;
+        for (const auto& v : vertices) {
+            boundsMin = glm::min(boundsMin, v.pos);
+            boundsMax = glm::max(boundsMax, v.pos);
+        }
     }
 
-	// upload vertex data to the GPU
+	// create the GPU buffers, later changes go through the dirty ranges
     void upload() {
         if (!VAO) {
             glGenVertexArrays(1, &VAO);
@@ -62,13 +162,21 @@ public:
 
             glBindVertexArray(VAO);
 
+            // a dynamic mesh gets storage for what its vectors have reserved, so growing into it never reallocates
+            vertexCapacity = dynamic ? vertices.capacity() : vertices.size();
+            indexCapacity = dynamic ? indices.capacity() : indices.size();
+            vertexCount = vertices.size();
+            indexCount = indices.size();
+
             // upload vertices
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+            glBufferData(GL_ARRAY_BUFFER, vertexCapacity * sizeof(Vertex), nullptr, usage());
+            if (vertexCount) glBufferSubData(GL_ARRAY_BUFFER, 0, vertexCount * sizeof(Vertex), vertices.data());
 
             // upload indices
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(unsigned int), nullptr, usage());
+            if (indexCount) glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexCount * sizeof(unsigned int), indices.data());
 
             // vertex attributes
             // basically what additional data we want to attach to each vertex, also define bindings here
@@ -88,13 +196,123 @@ public:
             glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, uv));
 
             glBindVertexArray(0);
+
+            trackMemory();
         }
-        else {
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), vertices.data());
+        else if (resident) {
+            markVerticesDirty(0, vertices.size());
+            markIndicesDirty(0, indices.size());
         }
     }
 
+    GLenum usage() const { return dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW; }
+
 private:
+	struct Range { size_t first; size_t count; };
+
+	std::string name;
+	bool dynamic = false;
+	bool resident = true;
+
+	// elements the GPU buffers have room for
+	size_t vertexCapacity = 0;
+	size_t indexCapacity = 0;
+
+	// what trackMemory() last reported
+	size_t trackedVertexCapacity = 0;
+	size_t trackedIndexCapacity = 0;
+	size_t trackedCpuVertices = 0;
+	size_t trackedCpuIndices = 0;
+
+	std::vector<Range> dirtyVertices;
+	std::vector<Range> dirtyIndices;
+
+	// past this many ranges they are folded into one, scattered edits end up as a single copy
+	static constexpr size_t MAX_DIRTY_RANGES = 32;
+
+	// both buffers are accounted under the VBO
+	void trackMemory() {
+		trackedVertexCapacity = vertexCapacity;
+		trackedIndexCapacity = indexCapacity;
+		trackedCpuVertices = vertices.capacity();
+		trackedCpuIndices = indices.capacity();
+		size_t gpuBytes = vertexCapacity * sizeof(Vertex) + indexCapacity * sizeof(unsigned int);
+		size_t cpuBytes = vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int);
+		resources.track(ResourceRegistry::Kind::Buffer, VBO, ResourceRegistry::Category::Mesh, gpuBytes, cpuBytes, name);
+	}
+
+	bool checkResident() const {
+		if (!resident) logger.error("mesh data is not resident on the CPU, call readback() before editing it");
+		return resident;
+	}
+
+	static void markDirty(std::vector<Range>& dirty, size_t first, size_t count) {
+		if (count == 0) return;
+		dirty.push_back({ first, count });
+		if (dirty.size() <= MAX_DIRTY_RANGES) return;
+
+		// one range covering all of them
+		size_t begin = first, end = first + count;
+		for (const Range& range : dirty) {
+			begin = std::min(begin, range.first);
+			end = std::max(end, range.first + range.count);
+		}
+		dirty.assign(1, { begin, end - begin });
+	}
+
+	template<typename T>
+	void collectBuffer(unsigned int buffer, const std::vector<T>& data, size_t& capacity, std::vector<Range>& dirty,
+		std::vector<Upload>& uploads, std::vector<unsigned char>& staging) {
+		if (dirty.empty()) return;
 
+		auto stage = [&](size_t first, size_t count, size_t reallocate) {
+			Upload upload = { buffer, reallocate, first * sizeof(T), count * sizeof(T), staging.size() };
+			if (upload.size) {
+				staging.resize(staging.size() + upload.size);
+				std::memcpy(staging.data() + upload.dataOffset, data.data() + first, upload.size);
+			}
+			uploads.push_back(upload);
+		};
+
+		// grown past the storage, reallocate with some headroom and send everything
+		if (data.size() > capacity) {
+			capacity = std::max(data.size(), capacity + capacity / 2);
+			stage(0, data.size(), capacity * sizeof(T));
+			dirty.clear();
+			return;
+		}
+
+		// sort, clamp to the current size and merge overlapping or touching ranges
+		std::sort(dirty.begin(), dirty.end(), [](const Range& a, const Range& b) { return a.first < b.first; });
+		size_t merged = 0;
+		size_t dirtyCount = 0;
+		for (const Range& range : dirty) {
+			size_t first = std::min(range.first, data.size());
+			size_t end = std::min(range.first + range.count, data.size());
+			if (first == end) continue;
+
+			if (merged > 0 && first <= dirty[merged - 1].first + dirty[merged - 1].count) {
+				Range& last = dirty[merged - 1];
+				size_t lastEnd = last.first + last.count;
+				if (end > lastEnd) {
+					dirtyCount += end - lastEnd;
+					last.count = end - last.first;
+				}
+			}
+			else {
+				dirty[merged++] = { first, end - first };
+				dirtyCount += end - first;
+			}
+		}
+		dirty.resize(merged);
+
+		// most of the buffer changed, orphan the storage so the copy doesn't wait on draws still reading it
+		if (dirtyCount * 2 >= data.size()) {
+			stage(0, data.size(), capacity * sizeof(T));
+		}
+		else {
+			for (const Range& range : dirty) stage(range.first, range.count, 0);
+		}
+		dirty.clear();
+	}
 };
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <memory>
 #include <string>
+#include <functional>
 
 #include "Mesh.h"
 #include "Material.h"
@@ -20,8 +21,13 @@ public:
 	}
 	~Object() = default;
 
-	// per-frame logic
-	void update(float deltaTime) {}
+	// per-frame logic, runs before the frame is prepared so meshes may be edited here
+	void update(float deltaTime) {
+		if (onUpdate) onUpdate(*this, deltaTime);
+	}
+
+	// optional behaviour set up by the scene
+	std::function<void(Object&, float)> onUpdate;
 
 	// the variables below must be assigned and valid before any draws are made
 	// as such, the modelloader class is responsible for doing this
@@ -9,8 +9,13 @@
 #include <iostream>
 #include <sys/stat.h>
 #include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <cstring>
 
 #include <logger.h>
+#include "../CommandBuffer.h"
+#include "../RenderStats.h"
 
 
 // shader exception type
@@ -33,6 +38,20 @@ public:
         }
         updateModTimes();
     }
+    Shader(const char* vertexPath, const char* geometryPath, const char* fragmentPath)
+        : m_vertexPath(vertexPath), m_geometryPath(geometryPath), m_fragmentPath(fragmentPath) {
+        if (!compile()) {
+            throw ShaderException("Initial shader compilation failed.");
+        }
+        updateModTimes();
+    }
+    // compute only program
+    explicit Shader(const char* computePath) : m_computePath(computePath) {
+        if (!compile()) {
+            throw ShaderException("Initial shader compilation failed.");
+        }
+        updateModTimes();
+    }
     ~Shader() {
         if (ID != 0 && glIsProgram(ID)) {
             glDeleteProgram(ID);
@@ -50,18 +69,31 @@ public:
     }
 
     /// <summary>
-    /// Checks shader source files for modification and recompiles if needed
+    /// Checks shader source files for modification without recompiling, no GL calls.
     /// </summary>
-    /// <returns>True if a reload occured and succeeded</returns>
-    bool checkHotReload() {
+    bool sourcesChanged() const {
+        if (!m_computePath.empty()) {
+            time_t cMod = getModTime(m_computePath);
+            return cMod != 0 && cMod != m_computeModTime;
+        }
+
         time_t vMod = getModTime(m_vertexPath);
         time_t fMod = getModTime(m_fragmentPath);
+        time_t gMod = m_geometryPath.empty() ? 0 : getModTime(m_geometryPath);
 
         if (vMod == 0 || fMod == 0) return false;
+        if (!m_geometryPath.empty() && gMod == 0) return false;
 
-        if (vMod != m_vertexModTime || fMod != m_fragmentModTime) {
-            m_vertexModTime = vMod;
-            m_fragmentModTime = fMod;
+        return vMod != m_vertexModTime || fMod != m_fragmentModTime || gMod != m_geometryModTime;
+    }
+
+    /// <summary>
+    /// Checks shader source files for modification and recompiles if needed
+    /// </summary>
+    /// <returns>True if a reload occured and succeeded</returns>
+    bool checkHotReload() {
+        if (sourcesChanged()) {
+            updateModTimes();
 
             if (!compile()) {
                 logger.error("Shader hot reload failed");
@@ -75,50 +107,107 @@ public:
         return false;
     }
 
+    /// <summary>
+    /// Uniform location from the cache built at link time, no GL calls and no allocation. -1 if the uniform is not active.
+    /// </summary>
+    int location(const char* name) const {
+        auto it = std::lower_bound(m_locations.begin(), m_locations.end(), name,
+            [](const std::pair<std::string, int>& entry, const char* key) { return std::strcmp(entry.first.c_str(), key) < 0; });
+        return it != m_locations.end() && it->first == name ? it->second : -1;
+    }
+
     // uniform setters
-    void setBool(const std::string& name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    void setBool(const char* name, bool value) const {
+        glUniform1i(location(name), value);
+    }
+    void setInt(const char* name, int value) const {
+        glUniform1i(location(name), value);
+    }
+    void setIntArray(const char* name, const int* values, int count) const {
+        glUniform1iv(location(name), count, values);
+    }
+    void setFloat(const char* name, float value) const {
+        glUniform1f(location(name), value);
+    }
+    void setVec2(const char* name, const glm::vec2& v) const {
+        glUniform2fv(location(name), 1, &v[0]);
     }
-    void setInt(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    void setVec2(const char* name, float x, float y) const {
+        glUniform2f(location(name), x, y);
     }
-    void setFloat(const std::string& name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    void setVec3(const char* name, const glm::vec3& v) const {
+        glUniform3fv(location(name), 1, &v[0]);
     }
-    void setVec2(const std::string& name, const glm::vec2& v) const {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &v[0]);
+    void setVec3(const char* name, float x, float y, float z) const {
+        glUniform3f(location(name), x, y, z);
     }
-    void setVec2(const std::string& name, float x, float y) const {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    void setVec4(const char* name, const glm::vec4& v) const {
+        glUniform4fv(location(name), 1, &v[0]);
     }
-    void setVec3(const std::string& name, const glm::vec3& v) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &v[0]);
+    void setVec4(const char* name, float x, float y, float z, float w) const {
+        glUniform4f(location(name), x, y, z, w);
     }
-    void setVec3(const std::string& name, float x, float y, float z) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    void setMat2(const char* name, const glm::mat2& m) const {
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &m[0][0]);
     }
-    void setVec4(const std::string& name, const glm::vec4& v) const {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &v[0]);
+    void setMat3(const char* name, const glm::mat3& m) const {
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &m[0][0]);
     }
-    void setVec4(const std::string& name, float x, float y, float z, float w) const {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    void setMat4(const char* name, const glm::mat4& m) const {
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &m[0][0]);
     }
-    void setMat2(const std::string& name, const glm::mat2& m) const {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &m[0][0]);
+
+    // recorded versions of the above, applied when the command buffer is replayed
+    void use(CommandBuffer& cmd) const {
+        RENDER_STAT_ADD(ShaderSwitches, 1);
+        cmd.useProgram(ID);
+    }
+    void setBool(CommandBuffer& cmd, const char* name, bool value) const {
+        RENDER_STAT_ADD(UniformUploads, 1);
+        cmd.uniform1i(location(name), value);
+    }
+    void setInt(CommandBuffer& cmd, const char* name, int value) const {
+        RENDER_STAT_ADD(UniformUploads, 1);
+        cmd.uniform1i(location(name), value);
+    }
+    void setIntArray(CommandBuffer& cmd, const char* name, const int* values, int count) const {
+        RENDER_STAT_ADD(UniformUploads, 1);
+        cmd.uniform1iv(location(name), values, count);
+    }
+    void setFloat(CommandBuffer& cmd, const char* name, float value) const {
+        RENDER_STAT_ADD(UniformUploads, 1);
+        cmd.uniform1f(location(name), value);
     }
-    void setMat3(const std::string& name, const glm::mat3& m) const {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &m[0][0]);
+    void setVec2(CommandBuffer& cmd, const char* name, const glm::vec2& v) const {
+        RENDER_STAT_ADD(UniformUploads, 1);
+        cmd.uniform2f(location(name), v);
     }
-    void setMat4(const std::string& name, const glm::mat4& m) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &m[0][0]);
+    void setVec3(CommandBuffer& cmd, const char* name, const glm::vec3& v) const {
+        RENDER_STAT_ADD(UniformUploads, 1);
+        cmd.uniform3f(location(name), v);
+    }
+    void setVec4(CommandBuffer& cmd, const char* name, const glm::vec4& v) const {
+        RENDER_STAT_ADD(UniformUploads, 1);
+        cmd.uniform4f(location(name), v);
+    }
+    void setMat4(CommandBuffer& cmd, const char* name, const glm::mat4& m) const {
+        RENDER_STAT_ADD(UniformUploads, 1);
+        cmd.uniformMatrix4f(location(name), m);
     }
 
 private:
     std::string m_vertexPath;
+    std::string m_geometryPath; // optional
     std::string m_fragmentPath;
+    std::string m_computePath; // set for compute programs, which have no other stage
 
     time_t m_vertexModTime = 0;
+    time_t m_geometryModTime = 0;
     time_t m_fragmentModTime = 0;
+    time_t m_computeModTime = 0;
+
+    // active uniform name -> location, sorted by name and filled after linking so lookups never need the context
+    std::vector<std::pair<std::string, int>> m_locations;
 
     // get file modification time
     static time_t getModTime(const std::string& path) {
@@ -128,8 +217,13 @@ private:
 
     // store current modification times
     void updateModTimes() {
+        if (!m_computePath.empty()) {
+            m_computeModTime = getModTime(m_computePath);
+            return;
+        }
         m_vertexModTime = getModTime(m_vertexPath);
         m_fragmentModTime = getModTime(m_fragmentPath);
+        if (!m_geometryPath.empty()) m_geometryModTime = getModTime(m_geometryPath);
     }
 
     // read shader source code from file
@@ -164,8 +258,35 @@ private:
         return shader;
     }
 
+    // link the compiled stages into ID, the stages are deleted either way
+    bool link(const unsigned int* stages, int count) {
+        unsigned int program = glCreateProgram();
+        for (int i = 0; i < count; i++) glAttachShader(program, stages[i]);
+        glLinkProgram(program);
+        for (int i = 0; i < count; i++) glDeleteShader(stages[i]);
+
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            GLchar infoLog[1024];
+            glGetProgramInfoLog(program, 1024, nullptr, infoLog);
+            logger.error("PROGRAM_LINKING_ERROR\n" + std::string(infoLog));
+            glDeleteProgram(program);
+            return false;
+        }
+
+        ID = program;
+        cacheLocations();
+        return true;
+    }
+
     // load, compile, and link the shader program
     bool compile() {
+        if (!m_computePath.empty()) {
+            unsigned int compute = compileShader(readFile(m_computePath), GL_COMPUTE_SHADER, "COMPUTE");
+            return compute != 0 && link(&compute, 1);
+        }
+
         std::string vertexCode = readFile(m_vertexPath);
         std::string fragmentCode = readFile(m_fragmentPath);
 
@@ -177,27 +298,48 @@ private:
             return false;
         }
 
-        unsigned int program = glCreateProgram();
-        glAttachShader(program, vertex);
-        glAttachShader(program, fragment);
-        glLinkProgram(program);
-
-        GLint success;
-        glGetProgramiv(program, GL_LINK_STATUS, &success);
-        if (!success) {
-            GLchar infoLog[1024];
-            glGetProgramInfoLog(program, 1024, nullptr, infoLog);
-            logger.error("PROGRAM_LINKING_ERROR\n" + std::string(infoLog));
-            glDeleteProgram(program);
-            glDeleteShader(vertex);
-            glDeleteShader(fragment);
-            return false;
+        // geometry stage is optional
+        unsigned int geometry = 0;
+        if (!m_geometryPath.empty()) {
+            geometry = compileShader(readFile(m_geometryPath), GL_GEOMETRY_SHADER, "GEOMETRY");
+            if (geometry == 0) {
+                glDeleteShader(vertex);
+                glDeleteShader(fragment);
+                return false;
+            }
         }
 
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        unsigned int stages[] = { vertex, fragment, geometry };
+        return link(stages, geometry ? 3 : 2);
+    }
 
-        ID = program;
-        return true;
+    // query every active uniform once, arrays get an entry per element plus their bare name
+    void cacheLocations() {
+        m_locations.clear();
+
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        for (GLint i = 0; i < count; i++) {
+            GLchar name[256];
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, i, sizeof(name), &length, &size, &type, name);
+
+            std::string uniform(name, length);
+            int loc = glGetUniformLocation(ID, name);
+            m_locations.emplace_back(uniform, loc);
+
+            // "lights[0]" is reported once with its array size
+            if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0) {
+                std::string base = uniform.substr(0, uniform.size() - 3);
+                m_locations.emplace_back(base, loc);
+                for (GLint e = 1; e < size; e++) {
+                    std::string element = base + "[" + std::to_string(e) + "]";
+                    m_locations.emplace_back(element, glGetUniformLocation(ID, element.c_str()));
+                }
+            }
+        }
+        std::sort(m_locations.begin(), m_locations.end());
     }
 };
\ No newline at end of file
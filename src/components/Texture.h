@@ -4,6 +4,9 @@
 #include <string>
 
 #include <logger.h>
+#include "../CommandBuffer.h"
+#include "../ResourceRegistry.h"
+#include "../RenderStats.h"
 
 class Texture {
 public:
@@ -19,14 +22,20 @@ public:
 	Texture(const Type type, const std::string path) : type(type), path(path) {}
 	~Texture() {
 		if (id != 0) {
+			resources.release(ResourceRegistry::Kind::Texture, id);
 			glDeleteTextures(1, &id);
 		}
 	}
 
 	void bind(unsigned int slot) {
+		RENDER_STAT_ADD(TextureBinds, 1);
 		glActiveTexture(GL_TEXTURE0 + slot);
 		glBindTexture(GL_TEXTURE_2D, id);
 	}
+	void bind(CommandBuffer& cmd, unsigned int slot) const {
+		RENDER_STAT_ADD(TextureBinds, 1);
+		cmd.bindTexture(slot, GL_TEXTURE_2D, id);
+	}
 	void unbind() {
 		glBindTexture(GL_TEXTURE_2D, 0);
 	}
@@ -1,12 +1,146 @@
 #include "Scene.h"
 #include "ModelLoader.h"
+#include "lights/DirectionalLight.h"
+#include "lights/PointLight.h"
 
 #include <string>
+#include <cmath>
 #include <logger.h>
 
 // TODO: should I create some kind of scene factory?
 //	it would be responsible for instantiating and setting up different scenes
 
+// a flat grid that a wave runs across, growing a row every few seconds
+// keeps the dynamic mesh path busy: every frame touches a band of rows (ranges that merge),
+// a new row is a small append and the reset back to the small grid rewrites all of it
+// the storage is sized for the largest grid up front, so none of this allocates once it runs
+static std::shared_ptr<Object> makeWavingGrid(std::shared_ptr<Shader> shader) {
+	constexpr int COLUMNS = 32;
+	constexpr int MIN_ROWS = 16;
+	constexpr int MAX_ROWS = 40;
+	constexpr float SPACING = 0.2f;
+	constexpr float BAND = 0.5f;		// half width of the wave, small enough that a frame only rewrites a few rows
+	constexpr float SPEED = 1.5f;
+	constexpr float GROW_INTERVAL = 2.0f;
+
+	auto vertex = [](int row, int column) {
+		Mesh::Vertex v = {};
+		v.pos = glm::vec3(column * SPACING, 0.0f, row * SPACING);
+		v.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+		v.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+		v.bitangent = glm::vec3(0.0f, 0.0f, -1.0f);
+		v.uv = glm::vec2(column / float(COLUMNS - 1), row / float(MIN_ROWS - 1));
+		return v;
+	};
+	// the two triangles between a row and the one before it
+	auto addRow = [vertex](std::vector<Mesh::Vertex>& vertices, std::vector<unsigned int>& indices, int row) {
+		for (int column = 0; column < COLUMNS; column++) vertices.push_back(vertex(row, column));
+		if (row == 0) return;
+		for (int column = 0; column + 1 < COLUMNS; column++) {
+			unsigned int i = (row - 1) * COLUMNS + column;
+			indices.insert(indices.end(), { i, i + COLUMNS, i + 1, i + 1, i + COLUMNS, i + COLUMNS + 1 });
+		}
+	};
+
+	std::vector<Mesh::Vertex> vertices;
+	std::vector<unsigned int> indices;
+	vertices.reserve(MAX_ROWS * COLUMNS);
+	indices.reserve((MAX_ROWS - 1) * (COLUMNS - 1) * 6);
+	for (int row = 0; row < MIN_ROWS; row++) addRow(vertices, indices, row);
+
+	auto grid = std::make_shared<Object>("waving grid");
+	grid->meshes.push_back(std::make_shared<Mesh>(std::move(vertices), std::move(indices), true, "waving grid"));
+	grid->material->shader = std::move(shader);
+	grid->material->albedo = glm::vec4(0.3f, 0.45f, 0.7f, 1.0f);
+	grid->material->roughness = 0.4f;
+	grid->material->metalness = 0.0f;
+
+	struct State {
+		int rows = MIN_ROWS;
+		float time = 0.0f;
+		float front = -BAND; // centre of the wave along the rows, last frame
+		float growTimer = 0.0f;
+	};
+	auto state = std::make_shared<State>();
+
+	grid->onUpdate = [=](Object& object, float deltaTime) {
+		Mesh& mesh = *object.meshes[0];
+		State& s = *state;
+
+		float before = s.front;
+		s.time += deltaTime;
+		float front = std::fmod(s.time * SPEED, s.rows * SPACING + 2.0f * BAND) - BAND;
+		s.front = front;
+
+		s.growTimer += deltaTime;
+		if (s.growTimer >= GROW_INTERVAL) {
+			s.growTimer = 0.0f;
+			if (s.rows < MAX_ROWS) {
+				size_t firstVertex = mesh.vertices.size();
+				size_t firstIndex = mesh.indices.size();
+				addRow(mesh.vertices, mesh.indices, s.rows++);
+				mesh.markVerticesDirty(firstVertex, mesh.vertices.size() - firstVertex);
+				mesh.markIndicesDirty(firstIndex, mesh.indices.size() - firstIndex);
+			}
+			else {
+				// back to the small flat grid, every element is rewritten
+				s.rows = MIN_ROWS;
+				mesh.vertices.clear();
+				mesh.indices.clear();
+				for (int row = 0; row < MIN_ROWS; row++) addRow(mesh.vertices, mesh.indices, row);
+				mesh.computeBounds();
+				mesh.markVerticesDirty(0, mesh.vertices.size());
+				mesh.markIndicesDirty(0, mesh.indices.size());
+				return;
+			}
+		}
+
+		// the rows the band covered last frame go flat again, the ones it covers now get the wave
+		for (int row = 0; row < s.rows; row++) {
+			float z = row * SPACING;
+			bool wasInBand = std::abs(z - before) < BAND;
+			bool inBand = std::abs(z - front) < BAND;
+			if (!wasInBand && !inBand) continue;
+
+			float x = (z - front) / BAND;
+			float height = inBand ? 0.25f * std::cos(x * 1.5707963f) * std::cos(x * 1.5707963f) : 0.0f;
+			float slope = inBand ? -0.25f * 1.5707963f * std::sin(x * 3.1415927f) / BAND : 0.0f;
+			glm::vec3 normal = glm::normalize(glm::vec3(0.0f, 1.0f, -slope));
+
+			for (int column = 0; column < COLUMNS; column++) {
+				Mesh::Vertex& v = mesh.vertices[row * COLUMNS + column];
+				v.pos.y = height;
+				v.normal = normal;
+				v.bitangent = glm::cross(normal, v.tangent);
+			}
+			mesh.markVerticesDirty(row * COLUMNS, COLUMNS);
+		}
+	};
+	return grid;
+}
+
+static void loadSpheres(Scene& scene) {
+	logger.info("loading spheres scene");
+
+	// small enough for software rasterizers, used on headless hosts
+	const glm::vec3 albedo[] = { glm::vec3(0.56f, 0.5f, 0.19f), glm::vec3(0.62f), glm::vec3(0.98f) };
+	for (int i = 0; i < 3; i++) {
+		auto sphere = ModelLoader::loadAsObjects("assets/models/cubeSphere.obj", scene.textures);
+		sphere[0]->transform.position = glm::vec3(2.0f * (i - 1), 0.0f, 0.0f);
+		sphere[0]->material->albedo = glm::vec4(albedo[i], 1.0f);
+		sphere[0]->material->roughness = 0.1f + 0.3f * i;
+		sphere[0]->material->metalness = i < 2 ? 1.0f : 0.0f;
+		scene.addObject(sphere[0]);
+	}
+
+	// below the spheres, the only mesh that changes after loading
+	auto grid = makeWavingGrid(scene.objects[0]->material->shader);
+	grid->transform.position = glm::vec3(-3.1f, -1.2f, -1.5f);
+	scene.addObject(grid);
+
+	scene.addLight(std::make_shared<DirectionalLight>(glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f)), glm::vec3(1.0f)));
+}
+
 static void loadScene01(Scene& scene) {
 	logger.info("loading debug scene 01");
 
@@ -47,4 +181,24 @@ static void loadScene01(Scene& scene) {
 		part->transform.translate(glm::vec3(0.0f, -1.9f, 0.0f));
 		scene.addObject(part);
 	}
+
+	// LIGHTS
+	scene.addLight(std::make_shared<DirectionalLight>(glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f)), glm::vec3(1.0f)));
+
+	// ring of point lights along the sponza floor, exercises light clustering
+	const int pointLights = 64;
+	for (int i = 0; i < pointLights; i++) {
+		float angle = glm::radians(360.0f * i / pointLights);
+		glm::vec3 pos = glm::vec3(std::cos(angle) * 6.0f, -1.2f, std::sin(angle) * 2.5f);
+		glm::vec3 color = glm::vec3(0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::sin(angle), 0.8f);
+		scene.addLight(std::make_shared<PointLight>(pos, color, 4.0f, 2.0f));
+	}
+}
+
+// scenes that can be picked by name on the command line (--scene)
+static bool loadSceneByName(const std::string& name, Scene& scene) {
+	if (name == "scene01") loadScene01(scene);
+	else if (name == "spheres") loadSpheres(scene);
+	else return false;
+	return true;
 }
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "lights/Light.h"
+
+// point light, position lives in transform.position
+class PointLight : public Light {
+public:
+	PointLight(glm::vec3 pos, glm::vec3 color, float intensity = 1.0f, float range = 5.0f)
+		: Light(pos), intensity(intensity), range(range)
+	{
+		this->color = color;
+	}
+
+	float intensity;
+	float range; // no contribution past this distance, also used for cluster binning
+};
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "lights/Light.h"
+
+// spot light, position lives in transform.position
+class SpotLight : public Light {
+public:
+	SpotLight(glm::vec3 pos, glm::vec3 dir, glm::vec3 color, float intensity = 1.0f, float range = 8.0f)
+		: Light(pos), direction(glm::normalize(dir)), intensity(intensity), range(range)
+	{
+		this->color = color;
+	}
+
+	glm::vec3 direction;
+	float intensity;
+	float range;
+
+	// cone angles in degrees, falloff happens between the two
+	float innerAngle = 20.0f;
+	float outerAngle = 30.0f;
+};
\ No newline at end of file
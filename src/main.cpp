@@ -1,16 +1,51 @@
 #include <iostream>
+#include <cstring>
+#include <cstdio>
 #include "App.h"
 
-int main() {
+static void printUsage() {
+	std::cout << "usage: KestrelGL [--headless] [--size WxH] [--frames N] [--screenshot out.ppm] [--scene name]\n"
+		<< "                 [--benchmark camera_path.txt] [--benchmark-out prefix] [--trace trace.json]\n"
+		<< "                 [--hitch-capture ms] [--hw-counters] [--alloc-test]\n";
+}
+
+int main(int argc, char** argv) {
 	logger.info("Hello CMake");
 	logger.info("C++ Standard " + std::to_string(__cplusplus));
 	logger.info("KestrelGL2");
 	logger.spacing();
 
+	int width = 1600, height = 900;
+	App::Options options;
+
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (std::strcmp(arg, "--headless") == 0) options.headless = true;
+		else if (std::strcmp(arg, "--frames") == 0 && hasValue) options.frames = std::atoi(argv[++i]);
+		else if (std::strcmp(arg, "--size") == 0 && hasValue && std::sscanf(argv[++i], "%dx%d", &width, &height) == 2) {}
+		else if (std::strcmp(arg, "--screenshot") == 0 && hasValue) options.screenshot = argv[++i];
+		else if (std::strcmp(arg, "--scene") == 0 && hasValue) options.scene = argv[++i];
+		else if (std::strcmp(arg, "--benchmark") == 0 && hasValue) options.benchmarkPath = argv[++i];
+		else if (std::strcmp(arg, "--benchmark-out") == 0 && hasValue) options.benchmarkOut = argv[++i];
+		else if (std::strcmp(arg, "--trace") == 0 && hasValue) options.trace = argv[++i];
+		else if (std::strcmp(arg, "--hw-counters") == 0) options.hardwareCounters = true;
+		else if (std::strcmp(arg, "--alloc-test") == 0) options.allocationTest = true;
+		else if (std::strcmp(arg, "--hitch-capture") == 0 && hasValue) options.hitchCaptureMs = static_cast<float>(std::atof(argv[++i]));
+		else {
+			printUsage();
+			return 1;
+		}
+	}
+
+	// nobody can close a window that doesn't exist
+	if (options.headless && options.frames <= 0 && options.benchmarkPath.empty()) options.frames = 300;
+
 	// create an App instance
 	// call the app run method 
-	auto app = App(1600, 900, "KestrelGL2");
+	auto app = App(width, height, "KestrelGL2", options);
 	app.run();
 
-	return 0;
+	return app.exitCode();
 }
\ No newline at end of file
@@ -1,12 +0,0 @@
-#version 460 core
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec2 aTexCoords;
-
-out vec2 TexCoords;
-
-void main() {
-	TexCoords = aTexCoords;
-
-	// no transformations needed, as we are already in NDC
-	gl_Position = vec4(aPos, 1.0);
-}
\ No newline at end of file
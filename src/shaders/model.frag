@@ -1,5 +1,9 @@
 #version 460 core
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+
+// weighted blended OIT, the transparent pass writes to two targets
+layout(location = 1) out float Revealage;
+uniform bool oitPass = false;
 
 // lights
 struct DirectionalLight { vec3 direction; vec3 color; };
@@ -7,17 +11,42 @@ struct DirectionalLight { vec3 direction; vec3 color; };
 uniform DirectionalLight dirLights[8];
 uniform int numDirLights;
 
+// clustered point/spot lights, see LightClusters.h
+struct ClusterLight {
+    vec4 positionRange;   // xyz position, w range
+    vec4 colorIntensity;  // rgb color, a intensity
+    vec4 direction;       // xyz spot direction, w 1 for spot lights
+    vec4 spotCone;        // x cos inner, y cos outer
+};
+layout(std430, binding = 1) readonly buffer ClusterLights { ClusterLight clusterLights[]; };
+layout(std430, binding = 2) readonly buffer ClusterGrid { uvec2 clusters[]; }; // offset, count
+layout(std430, binding = 3) readonly buffer ClusterIndices { uint lightIndices[]; };
+
+const uvec3 CLUSTER_GRID = uvec3(16, 9, 24);
+
+// skybox irradiance baked by sh_reduce.comp, rgb
+layout(std430, binding = 4) readonly buffer IrradianceSH { vec4 shCoefficients[9]; };
+
+// camera + cluster parameters
+// per frame data, see Renderer::FrameUniforms
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float textureLodBias;
+    vec2 clusterScreenSize;
+    float clusterNear;
+    float clusterFar;
+    int shadowPcfRadius;
+};
+
 // shadows
 uniform sampler2DArray shadowMaps;
 uniform mat4 lightSpaceMatrices[8]; // this array maps to shadowMaps
 
-// camera uniforms
-uniform vec3 viewPos;
-
 // texture maps
 // note that not all of these may be bound
 uniform sampler2D albedoMap;
-uniform bool hasAlbedoMap = false;
 uniform sampler2D normalMap;
 uniform bool hasNormalMap = false;
 uniform sampler2D metRoughMap;
@@ -25,9 +54,6 @@ uniform bool hasMetRoughMap = false;
 uniform sampler2D aoMap;
 uniform bool hasAOMap = false;
 
-// irradiance
-uniform vec3 shCoefficients[9];
-
 // other maps
 uniform samplerCube prefilterMap;
 uniform sampler2D brdfLUT;
@@ -41,9 +67,14 @@ uniform bool useMetRoughMap;
 uniform bool useAOMap;
 uniform bool useEmissionMap;
 
-uniform vec4 p_albedo; // rgb
-uniform float p_metalness;
-uniform float p_roughness;
+// per draw data, streamed through the ring buffer, see Renderer::DrawUniforms
+layout(std140, binding = 1) uniform DrawData {
+    mat4 model;
+    vec4 p_albedo; // rgb
+    float p_metalness;
+    float p_roughness;
+    bool hasAlbedoMap;
+};
 
 // attributes from vertex shader
 in vec3 vFragPos;
@@ -74,15 +105,42 @@ float calculateShadow(int lightIdx, vec3 normal, vec3 lightDir) {
     float shadow = 0.0;
     vec2 texelSize = 1.0 / vec2(textureSize(shadowMaps, 0));
 
-    for(int x = -1; x <= 1; ++x) {
-        for(int y = -1; y <= 1; ++y) {
-            // 3x3 PCF sample grid
+    // (2r+1)^2 PCF sample grid, the radius is lowered by the quality governor
+    int r = shadowPcfRadius;
+    for(int x = -r; x <= r; ++x) {
+        for(int y = -r; y <= r; ++y) {
             float pcfDepth = texture(shadowMaps, vec3(projCoords.xy + vec2(x, y) * texelSize, lightIdx)).r; 
             shadow += (projCoords.z - bias) > pcfDepth ? 1.0 : 0.0;        
         }    
     }
     // grab average
-    return shadow / 9.0;
+    float taps = float((2 * r + 1) * (2 * r + 1));
+    return shadow / taps;
+}
+
+// CLUSTERS
+// -------------------------------------------------
+uint clusterIndex() {
+    // exponential depth slices, must match LightClusters::sliceFromDepth
+    float viewDepth = -(view * vec4(vFragPos, 1.0)).z;
+    float slice = log(viewDepth / clusterNear) / log(clusterFar / clusterNear) * float(CLUSTER_GRID.z);
+
+    uvec3 cell = uvec3(
+        uint(gl_FragCoord.x / clusterScreenSize.x * float(CLUSTER_GRID.x)),
+        uint(gl_FragCoord.y / clusterScreenSize.y * float(CLUSTER_GRID.y)),
+        uint(max(slice, 0.0)));
+    cell = min(cell, CLUSTER_GRID - 1u);
+
+    return cell.x + CLUSTER_GRID.x * (cell.y + CLUSTER_GRID.y * cell.z);
+}
+
+// OIT
+// -------------------------------------------------
+// McGuire & Bavoil 2013, weight favours closer and more opaque fragments
+void writeOIT(vec4 color) {
+    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    FragColor = vec4(color.rgb * color.a, color.a) * weight;
+    Revealage = color.a;
 }
 
 // OTHER
@@ -111,17 +169,17 @@ vec3 evaluateSHIrradiance(vec3 n)
     float b7 = 1.092548 * x * z;
     float b8 = 0.546274 * (x * x - y * y);
 
-    vec3 L0 = shCoefficients[0] * b0;
+    vec3 L0 = shCoefficients[0].rgb * b0;
     vec3 L1 =
-          shCoefficients[1] * b1
-        + shCoefficients[2] * b2
-        + shCoefficients[3] * b3;
+          shCoefficients[1].rgb * b1
+        + shCoefficients[2].rgb * b2
+        + shCoefficients[3].rgb * b3;
     vec3 L2 =
-          shCoefficients[4] * b4
-        + shCoefficients[5] * b5
-        + shCoefficients[6] * b6
-        + shCoefficients[7] * b7
-        + shCoefficients[8] * b8;
+          shCoefficients[4].rgb * b4
+        + shCoefficients[5].rgb * b5
+        + shCoefficients[6].rgb * b6
+        + shCoefficients[7].rgb * b7
+        + shCoefficients[8].rgb * b8;
 
     return max(L0 * A0 + L1 * A1 + L2 * A2, vec3(0.0));
 }
@@ -135,17 +193,17 @@ void main() {
     float alpha = 1.0;
     if (hasAlbedoMap && useAlbedoMap) {
         // use the texture map
-        albedo = pow(texture(albedoMap, vTexCoords).rgb, vec3(2.2));
-        alpha = texture(albedoMap, vTexCoords).a;
+        albedo = pow(texture(albedoMap, vTexCoords, textureLodBias).rgb, vec3(2.2));
+        alpha = texture(albedoMap, vTexCoords, textureLodBias).a;
     } else {
         // use p_albedo
         albedo = p_albedo.rgb;
         alpha = p_albedo.a;
     }
 
-    float metallic = hasMetRoughMap && useMetRoughMap ? texture(metRoughMap, vTexCoords).b : p_metalness;
-    float roughness = hasMetRoughMap && useMetRoughMap ? texture(metRoughMap, vTexCoords).g : p_roughness;
-    float texAO = hasAOMap && useAOMap ? texture(aoMap, vTexCoords).r : 1.0;
+    float metallic = hasMetRoughMap && useMetRoughMap ? texture(metRoughMap, vTexCoords, textureLodBias).b : p_metalness;
+    float roughness = hasMetRoughMap && useMetRoughMap ? texture(metRoughMap, vTexCoords, textureLodBias).g : p_roughness;
+    float texAO = hasAOMap && useAOMap ? texture(aoMap, vTexCoords, textureLodBias).r : 1.0;
 
     // the TBN matrix is a transformation that converts tangentspace to worldspace
     // this is needed to be able to apply object transformations to the normal map
@@ -153,7 +211,7 @@ void main() {
     vec3 tangentNormal;
     if (useNormalMap && hasNormalMap) {
         // sample and remap to -1,1
-        tangentNormal = texture(normalMap, vTexCoords).rgb * 2.0 - 1.0;
+        tangentNormal = texture(normalMap, vTexCoords, textureLodBias).rgb * 2.0 - 1.0;
     } else {
         // 001
         tangentNormal = vec3(0.0, 0.0, 1.0);
@@ -202,6 +260,34 @@ void main() {
         Lo += (kD * albedo / PI) * radiance * diff * (1.0 - shadow);
     }
 
+    // Point/Spot, only the lights binned into this fragment's cluster
+    uvec2 cluster = clusters[clusterIndex()];
+    for (uint i = 0u; i < cluster.y; i++) {
+        ClusterLight light = clusterLights[lightIndices[cluster.x + i]];
+
+        vec3 toLight = light.positionRange.xyz - vFragPos;
+        float dist = length(toLight);
+        float range = light.positionRange.w;
+        if (dist >= range) continue;
+
+        vec3 L = toLight / dist;
+
+        // inverse square with a smooth window so the light reaches zero at its range
+        float window = clamp(1.0 - pow(dist / range, 4.0), 0.0, 1.0);
+        float attenuation = (window * window) / (dist * dist + 1.0);
+
+        // spot cone
+        if (light.direction.w > 0.5) {
+            float cosAngle = dot(-L, light.direction.xyz);
+            attenuation *= smoothstep(light.spotCone.y, light.spotCone.x, cosAngle);
+        }
+
+        float diff = max(dot(N, L), 0.0);
+        vec3 radiance = light.colorIntensity.rgb * light.colorIntensity.a;
+
+        Lo += (kD * albedo / PI) * radiance * diff * attenuation;
+    }
+
     // combine
     vec3 color = ambient + Lo;
 
@@ -213,12 +299,14 @@ void main() {
     // output
     if      (mode == 1) FragColor = vec4(albedo, 1.0);
     else if (mode == 2) FragColor = vec4(N * 0.5 + 0.5, 1.0);
-    else if (mode == 3) FragColor = vec4(texture(metRoughMap, vTexCoords).rgb, 1.0);
+    else if (mode == 3) FragColor = vec4(texture(metRoughMap, vTexCoords, textureLodBias).rgb, 1.0);
     else if (mode == 4) FragColor = vec4(vec3(diffuseIBL), 1.0);
     else if (mode == 5) FragColor = vec4(vec3(specularIBL), 1.0);
     else if (mode == 6) FragColor = vec4(vec3(prefilteredColor), 1.0);
     else if (mode == 7) FragColor = vec4(Lo, 1.0); // shadows system only
     else                FragColor = vec4(color, alpha);
 
+    if (oitPass) writeOIT(vec4(color, alpha));
+
 //    FragColor = vec4(vec3(gl_FragCoord.z), 1.0);
 }
\ No newline at end of file
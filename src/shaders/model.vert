@@ -13,9 +13,30 @@ out vec3 vBitangent;
 out vec2 vTexCoords;
 
 // transformation matrices
-uniform mat4 model; // object to world space
-uniform mat4 view;  // world to view space
-uniform mat4 projection; // view to clip space
+// model: object to world space, view: world to view space, projection: view to clip space
+// per frame data, see Renderer::FrameUniforms
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float textureLodBias;
+    vec2 clusterScreenSize;
+    float clusterNear;
+    float clusterFar;
+    int shadowPcfRadius;
+};
+
+// per draw data, streamed through the ring buffer, see Renderer::DrawUniforms
+layout(std140, binding = 1) uniform DrawData {
+    mat4 model;
+    vec4 p_albedo; // rgb
+    float p_metalness;
+    float p_roughness;
+    bool hasAlbedoMap;
+};
+
+// the depth pre-pass (prepass.vert) has to produce identical depth
+invariant gl_Position;
 
 void main() {
     mat3 M = mat3(model);
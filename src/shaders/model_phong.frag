@@ -1,12 +1,25 @@
 #version 460 core
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+
+// weighted blended OIT, the transparent pass writes to two targets
+layout(location = 1) out float Revealage;
+uniform bool oitPass = false;
 
 // camera uniforms
-uniform vec3 viewPos;
+// per frame data, see Renderer::FrameUniforms
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float textureLodBias;
+    vec2 clusterScreenSize;
+    float clusterNear;
+    float clusterFar;
+    int shadowPcfRadius;
+};
 
 // texture maps
 uniform sampler2D albedoMap;
-uniform bool hasAlbedoMap = false;
 uniform sampler2D normalMap;
 uniform bool hasNormalMap = false;
 uniform sampler2D metRoughMap;
@@ -14,8 +27,14 @@ uniform bool hasMetRoughMap = false;
 uniform sampler2D aoMap;
 uniform bool hasAOMap = false;
 
-// imgui stuff
-uniform vec4 p_albedo; // rgb
+// per draw data, streamed through the ring buffer, see Renderer::DrawUniforms
+layout(std140, binding = 1) uniform DrawData {
+    mat4 model;
+    vec4 p_albedo; // rgb
+    float p_metalness;
+    float p_roughness;
+    bool hasAlbedoMap;
+};
 
 // attributes from vertex shader
 in vec3 vFragPos;
@@ -24,6 +43,15 @@ in vec3 vTangent;
 in vec3 vBitangent;
 in vec2 vTexCoords;
 
+// OIT
+// -------------------------------------------------
+// McGuire & Bavoil 2013, weight favours closer and more opaque fragments
+void writeOIT(vec4 color) {
+    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    FragColor = vec4(color.rgb * color.a, color.a) * weight;
+    Revealage = color.a;
+}
+
 // MAIN
 // -------------------------------------------------
 void main() {
@@ -32,8 +60,8 @@ void main() {
 
     if (hasAlbedoMap) {
         // use the texture map
-        albedo = pow(texture(albedoMap, vTexCoords).rgb, vec3(2.2));
-        alpha = texture(albedoMap, vTexCoords).a;
+        albedo = pow(texture(albedoMap, vTexCoords, textureLodBias).rgb, vec3(2.2));
+        alpha = texture(albedoMap, vTexCoords, textureLodBias).a;
 
     } else {
         // use p_albedo
@@ -42,4 +70,6 @@ void main() {
     }
 
     FragColor = vec4(albedo, alpha);
+
+    if (oitPass) writeOIT(FragColor);
 }
\ No newline at end of file
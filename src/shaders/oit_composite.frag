@@ -0,0 +1,20 @@
+#version 460 core
+out vec4 FragColor;
+
+// weighted blended OIT targets, see model.frag
+uniform sampler2D accumTex;
+uniform sampler2D revealageTex;
+
+void main() {
+    ivec2 coords = ivec2(gl_FragCoord.xy);
+
+    // revealage is the product of (1 - alpha), 1.0 means nothing transparent landed here
+    float revealage = texelFetch(revealageTex, coords, 0).r;
+    if (revealage >= 1.0) discard;
+
+    vec4 accum = texelFetch(accumTex, coords, 0);
+    vec3 averageColor = accum.rgb / max(accum.a, 1e-5);
+
+    // blended over the opaque image with SRC_ALPHA, ONE_MINUS_SRC_ALPHA
+    FragColor = vec4(averageColor, 1.0 - revealage);
+}
@@ -0,0 +1,32 @@
+#version 460 core
+layout (location = 0) in vec3 aPos;
+
+// transformation matrices, same blocks as model.vert
+// per frame data, see Renderer::FrameUniforms
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float textureLodBias;
+    vec2 clusterScreenSize;
+    float clusterNear;
+    float clusterFar;
+    int shadowPcfRadius;
+};
+
+// per draw data, streamed through the ring buffer, see Renderer::DrawUniforms
+layout(std140, binding = 1) uniform DrawData {
+    mat4 model;
+    vec4 p_albedo; // rgb
+    float p_metalness;
+    float p_roughness;
+    bool hasAlbedoMap;
+};
+
+// must match model.vert bit for bit, the main pass depth tests with GL_EQUAL
+invariant gl_Position;
+
+void main() {
+    vec3 worldPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
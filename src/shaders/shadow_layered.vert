@@ -0,0 +1,21 @@
+#version 460 core
+#extension GL_ARB_shader_viewport_layer_array : require
+layout(location = 0) in vec3 aPos;
+
+uniform mat4 lightSpaceMatrices[8];
+
+// per draw data, streamed through the ring buffer, see Renderer::ShadowDrawUniforms
+// instance -> shadow array layer, filled per draw with the layers this mesh is visible in
+// packed 4 per ivec4 since std140 pads every element of a plain int array to 16 bytes
+layout(std140, binding = 1) uniform ShadowDrawData {
+    mat4 model;
+    ivec4 layerIndices[2];
+};
+
+void main() {
+    int layer = layerIndices[gl_InstanceID / 4][gl_InstanceID % 4];
+
+    // route this instance straight to its layer, no geometry stage needed
+    gl_Layer = layer;
+    gl_Position = lightSpaceMatrices[layer] * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 460 core
+layout(location = 0) in vec3 aPos;
+
+// per draw data, streamed through the ring buffer, see Renderer::ShadowDrawUniforms
+// instance -> shadow array layer, filled per draw with the layers this mesh is visible in
+// packed 4 per ivec4 since std140 pads every element of a plain int array to 16 bytes
+layout(std140, binding = 1) uniform ShadowDrawData {
+    mat4 model;
+    ivec4 layerIndices[2];
+};
+
+flat out int vLayer;
+
+void main() {
+    vLayer = layerIndices[gl_InstanceID / 4][gl_InstanceID % 4];
+
+    // world space, the geometry stage applies the light transform
+    gl_Position = model * vec4(aPos, 1.0);
+}